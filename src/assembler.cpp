@@ -1,31 +1,95 @@
 #include "assembler.h"
 #include "code_gen.h"
-#include "utils.h"
+#include "dead_code.h"
+#include "layout.h"
+#include "object.h"
+#include "output_pipeline.h"
+#include "reg_alloc.h"
+#include "source_map.h"
 
 #include <iomanip>
 #include <utility>
 
 
-Assembler::Assembler(std::string  input) : input_(std::move(input)) {}
+Assembler::Assembler(std::string  input, AssemblerOptions options)
+    : input_(std::move(input)), options_(options) {}
+
+AST Assembler::build_ast() const {
+    auto* profiler = options_.profiler;
+    // the parser pulls its tokens from the lexer, so the two are measured together
+    AST ast = measured(profiler, "lex+parse", [&] {
+        Lexer lexer(input_, std::make_shared<SymbolInterner>(), options_.core);
+        if (!uses_preprocessor(input_)) return Parser(lexer).parse();
+        Preprocessor preprocessor(lexer, options_.fragments, options_.included_files);
+        return Parser(preprocessor).parse();
+    });
+
+    if (options_.eliminate_dead_code) {
+        const auto report = measured(profiler, "dead code", [&] { return eliminate_dead_code(ast); });
+        if (options_.diagnostics) print_report(*options_.diagnostics, report);
+    }
+
+    // virtual registers have to be mapped before anything is encoded
+    const auto registers = measured(profiler, "registers", [&] { return allocate_registers(ast); });
+    if (registers.virtual_registers > 0 && options_.diagnostics) {
+        print_report(*options_.diagnostics, registers);
+    }
+
+    if (options_.optimize_layout) {
+        const auto report = measured(profiler, "layout", [&] {
+            std::optional<BlockProfile> profile;
+            if (!options_.layout_profile_path.empty()) profile = load_block_profile(options_.layout_profile_path);
+            return optimize_layout(ast, options_.core, profile ? &*profile : nullptr);
+        });
+        if (options_.diagnostics) print_report(*options_.diagnostics, report);
+    }
+    return ast;
+}
+
+BinaryOutput Assembler::encode() const {
+    auto ast = build_ast();
+    CodeGenerator code_gen(options_.core);
+    const auto sym_table = measured(options_.profiler, "pass1", [&] { return code_gen.pass1(ast); });
+    auto output = measured(options_.profiler, "pass2", [&] { return code_gen.pass2(ast, sym_table); });
+    if (options_.profiler) options_.profiler->set_instructions(output.instructions.size() / 4);
+    return output;
+}
 
 void Assembler::assemble(
     const std::string& instruction_file_path, const std::string& data_file_path,
     const std::string& instruction_template_path, const std::string& data_template_path
 ) const {
-    Lexer lexer(input_);
-    Parser parser(lexer);
-    AST ast = parser.parse();
-
-    CodeGenerator code_gen;
-    const auto sym_table = code_gen.pass1(ast);
-    const auto [instructions, data] = code_gen.pass2(ast, sym_table);
-
-    utils::replace_marker_with_output(
-        instruction_template_path, instruction_file_path,
-        subs_token.data(), instructions
-    );
-    utils::replace_marker_with_output(
-        data_template_path, data_file_path,
-        subs_token.data(), data
-    );
+    auto ast = build_ast();
+    CodeGenerator code_gen(options_.core);
+    const auto sym_table = measured(options_.profiler, "pass1", [&] { return code_gen.pass1(ast); });
+
+    // both memories are rendered and written while pass2 encodes them; an
+    // error unwinds through the pipeline, which then discards its files
+    const auto instructions = measured(options_.profiler, "pass2+output", [&] {
+        OutputPipeline pipeline({instruction_template_path, instruction_file_path},
+                                {data_template_path, data_file_path});
+        const auto output = code_gen.pass2(ast, sym_table, nullptr, &pipeline);
+        pipeline.finish();
+        return output.instructions.size() / 4;
+    });
+    if (options_.profiler) options_.profiler->set_instructions(instructions);
+
+    // only once the memories are in place, so a failed run leaves the old map matching them
+    if (!options_.source_map_path.empty()) {
+        measured(options_.profiler, "source map", [&] {
+            write_source_map(options_.source_map_path, build_source_map(ast));
+        });
+    }
+}
+
+void Assembler::assemble_object(const std::string& object_file_path) const {
+    auto ast = build_ast();
+    CodeGenerator code_gen(options_.core);
+    const auto sym_table = measured(options_.profiler, "pass1", [&] { return code_gen.pass1(ast); });
+    std::vector<Relocation> relocations;
+    auto output = measured(options_.profiler, "pass2", [&] { return code_gen.pass2(ast, sym_table, &relocations); });
+    if (options_.profiler) options_.profiler->set_instructions(output.instructions.size() / 4);
+    measured(options_.profiler, "write object", [&] {
+        write_object(object_file_path, make_object(ast, sym_table, std::move(output), std::move(relocations)));
+    });
 }
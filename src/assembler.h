@@ -2,20 +2,46 @@
 #define ASSEMBLER_H
 
 
+#include "code_gen.h"
 #include "parser.h"
+#include "perf_counters.h"
+#include "preprocessor.h"
 
+#include <ostream>
+
+
+struct AssemblerOptions {
+    TargetCore core = TargetCore::CLASSIC;
+    bool eliminate_dead_code = false;
+    bool optimize_layout = false;
+    std::string layout_profile_path; // block execution counts for the layout pass, optional
+    std::string source_map_path;     // where assemble() writes the address to source line map, optional
+    std::ostream* diagnostics = nullptr; // receives the optimization reports, if set
+    PhaseProfiler* profiler = nullptr;   // times each phase and reads the hardware counters, if set
+    FragmentCache* fragments = nullptr;  // included files lexed by earlier assemblies, if set
+    std::vector<std::string>* included_files = nullptr; // receives the path of every .include, if set
+};
 
 class Assembler {
 public:
-    explicit Assembler(std::string  input);
+    explicit Assembler(std::string  input, AssemblerOptions options = {});
+
+    // parses the input and runs the AST passes the options ask for, ready for code generation
+    AST build_ast() const;
+    // runs every pass and returns the encoded memories
+    BinaryOutput encode() const;
 
     void assemble(
         const std::string& instruction_file_path, const std::string& data_file_path,
         const std::string& instruction_template_path, const std::string& data_template_path
     ) const;
 
+    // writes a relocatable object for the link step instead of the memories
+    void assemble_object(const std::string& object_file_path) const;
+
 private:
     std::string input_;
+    AssemblerOptions options_;
 };
 
-#endif // ASSEMBLER_H
\ No newline at end of file
+#endif // ASSEMBLER_H
@@ -0,0 +1,103 @@
+#include "cfg.h"
+
+
+bool is_branch(const Node* node) {
+    if (node->type != NodeType::INSTRUCTION) return false;
+    if (dynamic_cast<const JTypeInst*>(node)) return true;
+    const auto* inst = dynamic_cast<const ITypeInst*>(node);
+    return inst && (inst->mnemonic == "beq" || inst->mnemonic == "bne");
+}
+
+bool is_unconditional_branch(const Node* node) {
+    if (const auto* j_inst = dynamic_cast<const JTypeInst*>(node)) return j_inst->mnemonic == "j";
+    const auto* inst = dynamic_cast<const ITypeInst*>(node);
+    return inst && inst->mnemonic == "beq" && inst->rs == inst->rt;
+}
+
+std::string branch_target(const Node* node) {
+    if (const auto* j_inst = dynamic_cast<const JTypeInst*>(node)) {
+        return j_inst->is_label_ref ? j_inst->target : std::string{};
+    }
+    return dynamic_cast<const ITypeInst*>(node)->imm_or_label;
+}
+
+bool targets_label(const Node* branch) {
+    if (const auto* j_inst = dynamic_cast<const JTypeInst*>(branch)) return j_inst->is_label_ref;
+    return dynamic_cast<const ITypeInst*>(branch)->is_label_ref;
+}
+
+bool is_section_directive(const Node* node) {
+    if (node->type != NodeType::DIRECTIVE) return false;
+    const auto* dir = dynamic_cast<const DirectiveNode*>(node);
+    return dir->name == "text" || dir->name == "data";
+}
+
+bool is_symbol_directive(const Node* node) {
+    if (node->type != NodeType::DIRECTIVE) return false;
+    return dynamic_cast<const DirectiveNode*>(node)->name == "globl";
+}
+
+ControlFlowGraph::ControlFlowGraph(const AST& ast) {
+    auto current_section = Section::TEXT;
+    auto block_open = false;      // the last block can still take more nodes
+    auto block_has_code = false;  // the last block holds more than labels
+
+    for (size_t idx = 0; idx < ast.nodes.size(); ++idx) {
+        const auto* node = ast.nodes[idx].get();
+
+        if (is_section_directive(node)) {
+            const auto* dir = dynamic_cast<const DirectiveNode*>(node);
+            current_section = dir->name == "text" ? Section::TEXT : Section::DATA;
+            continue;
+        }
+        if (is_symbol_directive(node)) {
+            symbol_directives_.push_back(idx);
+            continue;
+        }
+        if (current_section == Section::DATA) {
+            data_nodes_.push_back(idx);
+            continue;
+        }
+
+        // a label starts a new block, unless the open one holds only labels so far
+        if (!block_open || (node->type == NodeType::LABEL && block_has_code)) {
+            blocks_.emplace_back();
+            block_open = true;
+            block_has_code = false;
+        }
+
+        auto& block = blocks_.back();
+        block.nodes.push_back(idx);
+        if (node->type == NodeType::LABEL) {
+            const auto* label = dynamic_cast<const LabelNode*>(node);
+            block.labels.push_back(label->name);
+            label_blocks_[label->name] = blocks_.size() - 1;
+        } else {
+            block_has_code = true;
+        }
+
+        if (is_branch(node)) {
+            block.branch = node;
+            block_open = false;
+            if (!targets_label(node)) has_address_targets_ = true;
+        }
+    }
+
+    for (size_t id = 0; id < blocks_.size(); ++id) {
+        auto& block = blocks_[id];
+        if (block.branch) {
+            block.taken = block_of(branch_target(block.branch));
+        }
+        if (id + 1 < blocks_.size() && !(block.branch && is_unconditional_branch(block.branch))) {
+            block.fall_through = id + 1;
+        }
+        if (block.taken) blocks_[*block.taken].preds.push_back(id);
+        if (block.fall_through) blocks_[*block.fall_through].preds.push_back(id);
+    }
+}
+
+std::optional<size_t> ControlFlowGraph::block_of(const std::string& label) const {
+    const auto it = label_blocks_.find(label);
+    if (it != label_blocks_.end()) return it->second;
+    return std::nullopt;
+}
@@ -0,0 +1,57 @@
+#ifndef CFG_H
+#define CFG_H
+
+
+#include "parser.h"
+
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+
+struct BasicBlock {
+    std::vector<size_t> nodes;          // indices into AST::nodes, in program order
+    std::vector<std::string> labels;    // labels defined at the block entry
+    const Node* branch = nullptr;       // terminating branch or jump, if any
+    std::optional<size_t> taken;        // block the branch jumps to
+    std::optional<size_t> fall_through; // next block, if execution can fall into it
+    std::vector<size_t> preds;
+};
+
+// basic blocks of the .text section, delimited by labels and branches.
+// sections are resolved here, so the graph can be built before pass1
+class ControlFlowGraph {
+public:
+    explicit ControlFlowGraph(const AST& ast);
+
+    [[nodiscard]] const std::vector<BasicBlock>& blocks() const { return blocks_; }
+    // .data nodes (section directives excluded), in program order
+    [[nodiscard]] const std::vector<size_t>& data_nodes() const { return data_nodes_; }
+    // .globl directives of either section; they belong to no block or region
+    [[nodiscard]] const std::vector<size_t>& symbol_directives() const { return symbol_directives_; }
+    [[nodiscard]] std::optional<size_t> block_of(const std::string& label) const;
+    // some branch or jump goes to a numeric address or offset, which may land in any
+    // block; such code can neither be removed nor moved
+    [[nodiscard]] bool has_address_targets() const { return has_address_targets_; }
+
+private:
+    std::vector<BasicBlock> blocks_;
+    std::vector<size_t> data_nodes_;
+    std::vector<size_t> symbol_directives_;
+    std::unordered_map<std::string, size_t> label_blocks_;
+    bool has_address_targets_ = false;
+};
+
+// beq, bne, j and jal
+bool is_branch(const Node* node);
+// j, or beq rX, rX which is the only unconditional jump on the classic core
+bool is_unconditional_branch(const Node* node);
+// label the branch jumps to, empty for a jump to a numeric address
+std::string branch_target(const Node* node);
+// false for a numeric target
+bool targets_label(const Node* branch);
+bool is_section_directive(const Node* node);
+// .globl, which only marks labels as exported
+bool is_symbol_directive(const Node* node);
+
+#endif // CFG_H
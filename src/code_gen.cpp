@@ -1,20 +1,45 @@
 #include "code_gen.h"
+#include "utils.h"
 
+#include <algorithm>
 #include <sstream>
 #include <bitset>
+#include <cctype>
 
 
+namespace {
+
+// bytes handed to an EncodeListener at a time
+constexpr uint32_t LISTENER_CHUNK = 16 * 1024;
+
+std::string mnemonic_of(const Node* node) {
+    if (const auto* r_inst = dynamic_cast<const RTypeInst*>(node)) return r_inst->mnemonic;
+    if (const auto* i_inst = dynamic_cast<const ITypeInst*>(node)) return i_inst->mnemonic;
+    if (const auto* j_inst = dynamic_cast<const JTypeInst*>(node)) return j_inst->mnemonic;
+    return {};
+}
+
+}
+
+CodeGenerator::CodeGenerator(const TargetCore core) : core_(core) {}
+
 uint32_t CodeGenerator::get_reg_num(const std::string& reg) const {
     const auto it = REG_MAP.find(reg);
-    if (it == REG_MAP.end()) throw std::runtime_error("Invalid register: " + reg);
+    if (it == REG_MAP.end()) {
+        if (is_virtual_register(reg)) throw std::runtime_error("Unallocated virtual register: " + reg);
+        throw std::runtime_error("Invalid register: " + reg);
+    }
     return it->second;
 }
 
-SymbolTable CodeGenerator::pass1(const AST& ast) {
-    SymbolTable sym_table;
+SymbolTable CodeGenerator::pass1(AST& ast) {
+    SymbolTable sym_table(ast.symbols);
     uint32_t text_addr = 0;
     uint32_t data_addr = 0;
     auto current_section = Section::TEXT;
+    std::unordered_map<std::string, size_t> literal_index;
+    literal_pool_.clear();
+    literal_lines_.clear();
     
     for (auto& node : ast.nodes) {
         node->section = current_section;
@@ -28,30 +53,84 @@ SymbolTable CodeGenerator::pass1(const AST& ast) {
 
         if (node->type == NodeType::LABEL) {
             const auto* label = dynamic_cast<LabelNode*>(node.get());
-            sym_table.add(label->name, node->address);
+            if (label->symbol != NO_SYMBOL) {
+                sym_table.add(label->symbol, node->address, current_section);
+            } else {
+                sym_table.add(label->name, node->address, current_section);
+            }
         } else if (node->type == NodeType::INSTRUCTION) {
-            if (current_section == Section::DATA) {
-                throw std::runtime_error("Instructions not allowed in .data section");
+            check_instruction(node.get(), current_section);
+            if (auto* i_inst = dynamic_cast<ITypeInst*>(node.get()); i_inst && i_inst->is_literal) {
+                // constants are keyed by value, so 16 and 0x10 share an entry
+                auto value = i_inst->imm_or_label.substr(1);
+                if (!value.empty() && (std::isdigit(static_cast<unsigned char>(value[0])) || value[0] == '-')) {
+                    value = std::to_string(encode_word(value, sym_table));
+                }
+                i_inst->set_label("=" + value, *ast.symbols);
+                if (literal_index.try_emplace(value, literal_pool_.size()).second) {
+                    literal_pool_.push_back(value);
+                    literal_lines_.push_back(node->line);
+                }
             }
             text_addr += 4;
         } else if (node->type == NodeType::DIRECTIVE) {
-            const auto* dir = dynamic_cast<DirectiveNode*>(node.get());
+            auto* dir = dynamic_cast<DirectiveNode*>(node.get());
             if (dir->name == "text") {
                 current_section = Section::TEXT;
             } else if (dir->name == "data") {
                 current_section = Section::DATA;
-            } else if (dir->name == "word") {
+            } else if (dir->name == "word" || dir->name == "space" || dir->name == "incbin") {
                 if (current_section == Section::TEXT) {
-                    throw std::runtime_error(".word directive not allowed in .text section");
+                    throw std::runtime_error("." + dir->name + " directive not allowed in .text section");
                 }
-                data_addr += 4 * dir->values.size();
+                if (dir->name == "incbin") {
+                    // pass2 copies straight out of the mapping
+                    dir->contents = std::make_shared<const MappedFile>(dir->values.front());
+                    if (dir->contents->size() > 0x7FFFFFFC) {
+                        throw std::runtime_error("File too large for .incbin: " + dir->values.front());
+                    }
+                    dir->size = static_cast<uint32_t>((dir->contents->size() + 3) & ~size_t{3});
+                }
+                data_addr += dir->data_size();
             }
         }
     }
+
+    // the literal pool goes after all the data
+    for (const auto& value : literal_pool_) {
+        sym_table.add("=" + value, data_addr, Section::DATA);
+        data_addr += 4;
+    }
     return sym_table;
 }
 
-BinaryOutput CodeGenerator::pass2(const AST& ast, const SymbolTable& sym_table) {
+void CodeGenerator::check_instruction(const Node* node, const Section section) const {
+    if (section == Section::DATA) {
+        throw std::runtime_error("Instructions not allowed in .data section");
+    }
+    if (core_ == TargetCore::CLASSIC) {
+        if (const auto mnemonic = mnemonic_of(node); EXTENDED_INSTRUCTIONS.contains(mnemonic)) {
+            throw std::runtime_error("Instruction '" + mnemonic + "' at line " + std::to_string(node->line) +
+                                     " is not supported by the classic core (use --core extended)");
+        }
+    }
+}
+
+uint32_t CodeGenerator::encode_instruction(const Node* node, const SymbolTable& sym_table) const {
+    if (const auto* r_inst = dynamic_cast<const RTypeInst*>(node)) {
+        return encode_r(r_inst);
+    } else if (const auto* i_inst = dynamic_cast<const ITypeInst*>(node)) {
+        return encode_i(i_inst, node->address, sym_table);
+    } else if (const auto* j_inst = dynamic_cast<const JTypeInst*>(node)) {
+        return encode_j(j_inst, node->address, sym_table);
+    }
+    throw std::runtime_error("Unknown instruction type");
+}
+
+BinaryOutput CodeGenerator::pass2(const AST& ast, const SymbolTable& sym_table, std::vector<Relocation>* relocations,
+                                  EncodeListener* listener) {
+    relocations_ = relocations;
+
     // calculate size for each section
     uint32_t text_size = 0;
     uint32_t data_size = 0;
@@ -63,12 +142,14 @@ BinaryOutput CodeGenerator::pass2(const AST& ast, const SymbolTable& sym_table)
             }
         } else if (node->type == NodeType::DIRECTIVE) {
             const auto* dir = dynamic_cast<DirectiveNode*>(node.get());
-            if (dir->name == "word" && node->section == Section::DATA) {
-                data_size += 4 * dir->values.size();
+            if (node->section == Section::DATA) {
+                data_size += dir->data_size();
             }
         }
     }
 
+    data_size += 4 * literal_pool_.size();
+
     BinaryOutput output;
     output.instructions.resize(text_size);
     output.data.resize(data_size);
@@ -76,32 +157,53 @@ BinaryOutput CodeGenerator::pass2(const AST& ast, const SymbolTable& sym_table)
     uint32_t text_pos = 0;
     uint32_t data_pos = 0;
 
+    // both sections are filled in address order, so everything below pos is final
+    uint32_t text_sent = 0;
+    uint32_t data_sent = 0;
+    auto send = [&](const Section section, const bool all) {
+        if (!listener) return;
+        const auto& bytes = section == Section::TEXT ? output.instructions : output.data;
+        const auto pos = section == Section::TEXT ? text_pos : data_pos;
+        auto& sent = section == Section::TEXT ? text_sent : data_sent;
+        if (pos > sent && (all || pos - sent >= LISTENER_CHUNK)) {
+            listener->encoded(section, bytes.data() + sent, pos - sent);
+            sent = pos;
+        }
+    };
+
     for (const auto& node : ast.nodes) {
         if (node->type == NodeType::INSTRUCTION) {
             if (node->section == Section::TEXT) {
-                uint32_t machine_code;
-                if (auto* r_inst = dynamic_cast<RTypeInst*>(node.get())) {
-                    machine_code = encode_r(r_inst);
-                } else if (auto* i_inst = dynamic_cast<ITypeInst*>(node.get())) {
-                    machine_code = encode_i(i_inst, node->address, sym_table);
-                } else {
-                    throw std::runtime_error("Unknown instruction type");
-                }
-                write_uint32(output.instructions, text_pos, machine_code);
+                const auto machine_code = encode_instruction(node.get(), sym_table);
+                utils::write_uint32(&output.instructions[text_pos], machine_code);
                 text_pos += 4;
+                send(Section::TEXT, false);
             }
         } else if (node->type == NodeType::DIRECTIVE) {
             auto* dir = static_cast<DirectiveNode*>(node.get());
             if (dir->name == "word" && node->section == Section::DATA) {
-                for (const auto& val : dir->values) {
-                    uint32_t word_val = encode_word(val, sym_table);
-                    write_uint32(output.data, data_pos, word_val);
+                for (size_t i = 0; i < dir->values.size(); ++i) {
+                    utils::write_uint32(&output.data[data_pos], encode_word(dir->values[i], sym_table, data_pos, dir->symbol(i)));
                     data_pos += 4;
                 }
+            } else if (dir->name == "incbin" && node->section == Section::DATA) {
+                copy_contents(dir, output.data, data_pos);
+                data_pos += dir->size;
+            } else if (dir->name == "space" && node->section == Section::DATA) {
+                data_pos += dir->size; // already zero
             }
+            send(Section::DATA, false);
         }
     }
 
+    for (size_t i = 0; i < literal_pool_.size(); ++i) {
+        utils::write_uint32(&output.data[data_pos], encode_literal(i, sym_table, data_pos));
+        data_pos += 4;
+    }
+    send(Section::TEXT, true);
+    send(Section::DATA, true);
+
+    relocations_ = nullptr;
     return output;
 }
 
@@ -152,15 +254,21 @@ uint32_t CodeGenerator::encode_i(const ITypeInst* inst, uint32_t current_addr, c
     const uint32_t rt_num = get_reg_num(inst->rt);
     int32_t imm;
 
-    if (inst->is_label_ref) {
-        const auto addr_opt = sym_table.get(inst->imm_or_label);
+    const auto relative = inst->mnemonic == "beq" || inst->mnemonic == "bne";
+    const auto unsigned_imm = inst->mnemonic == "andi" || inst->mnemonic == "ori";
+    const auto type = relative ? RelocationType::BRANCH16 : unsigned_imm ? RelocationType::ABS16U : RelocationType::ABS16;
+
+    if (inst->is_label_ref && relocate(inst->imm_or_label, sym_table, type, Section::TEXT, current_addr)) {
+        imm = 0;
+    } else if (inst->is_label_ref) {
+        const auto addr_opt = sym_table.get(inst->symbol, inst->imm_or_label);
         if (!addr_opt) throw std::runtime_error("Unresolved label: " + inst->imm_or_label);
         const uint32_t label_addr = *addr_opt;
 
-        if (inst->mnemonic == "beq") {
+        if (relative) {
             imm = (static_cast<int32_t>(label_addr) - static_cast<int32_t>(current_addr + 4)) / 4;
         } else {
-            imm = label_addr; // absolute for lw/sw
+            imm = label_addr; // absolute for lw/sw and the immediates
         }
     } else {
         try {
@@ -170,27 +278,96 @@ uint32_t CodeGenerator::encode_i(const ITypeInst* inst, uint32_t current_addr, c
         }
     }
 
-    if (imm < -32768 || imm > 32767) throw std::runtime_error("Immediate overflow: " + std::to_string(imm));
+    // andi/ori zero-extend their immediate, the rest sign-extend it
+    if (unsigned_imm) {
+        if (imm < 0 || imm > 65535) throw std::runtime_error("Immediate overflow: " + std::to_string(imm));
+    } else if (imm < -32768 || imm > 32767) {
+        throw std::runtime_error("Immediate overflow: " + std::to_string(imm));
+    }
 
-    // beq: rs, rt, imm;
+    // beq/bne: rs, rt, imm;
     // lw/sw: rs(base), rt, imm
+    // addi/slti/andi/ori: rs(src), rt(dst), imm
     return (opcode << 26) | (rs_num << 21) | (rt_num << 16) | (static_cast<uint32_t>(imm) & 0xFFFF);
 }
 
-uint32_t CodeGenerator::encode_word(const std::string& val, const SymbolTable& sym_table) const {
-    try {
-        return std::stoll(val, nullptr, 0);
-    } catch (...) {
-        const auto addr_opt = sym_table.get(val);
-        if (!addr_opt) throw std::runtime_error("Unresolved label in .word: " + val);
-        return *addr_opt;
+uint32_t CodeGenerator::encode_j(const JTypeInst* inst, const uint32_t current_addr, const SymbolTable& sym_table) const {
+    const auto opcode_it = OPCODES.find(inst->mnemonic);
+    if (opcode_it == OPCODES.end()) throw std::runtime_error("Unknown J-type: " + inst->mnemonic);
+
+    if (inst->is_label_ref && relocate(inst->target, sym_table, RelocationType::JUMP26, Section::TEXT, current_addr)) {
+        return opcode_it->second << 26;
+    }
+
+    uint32_t target;
+    if (inst->is_label_ref) {
+        const auto addr_opt = sym_table.get(inst->symbol, inst->target);
+        if (!addr_opt) throw std::runtime_error("Unresolved label: " + inst->target);
+        target = *addr_opt;
+    } else {
+        try {
+            target = static_cast<uint32_t>(std::stoll(inst->target, nullptr, 0));
+        } catch (...) {
+            throw std::runtime_error("Invalid jump target: " + inst->target);
+        }
+    }
+
+    // the 26-bit field holds a word index inside the 256 MB region of the next instruction
+    if (target % 4 != 0) throw std::runtime_error("Unaligned jump target: " + inst->target);
+    if ((target & 0xF0000000) != ((current_addr + 4) & 0xF0000000)) {
+        throw std::runtime_error("Jump target out of range: " + inst->target);
+    }
+
+    return (opcode_it->second << 26) | ((target >> 2) & 0x3FFFFFF);
+}
+
+uint32_t CodeGenerator::encode_word(const std::string& val, const SymbolTable& sym_table, const uint32_t data_offset,
+                                    const uint32_t symbol) const {
+    // an interned value is an identifier, never a number
+    if (symbol == NO_SYMBOL) {
+        try {
+            return std::stoll(val, nullptr, 0);
+        } catch (...) {
+        }
+    }
+    if (relocate(val, sym_table, RelocationType::ABS32, Section::DATA, data_offset)) return 0;
+    const auto addr_opt = sym_table.get(symbol, val);
+    if (!addr_opt) throw std::runtime_error("Unresolved label in .word: " + val);
+    return *addr_opt;
+}
+
+uint32_t CodeGenerator::encode_literal(const size_t index, const SymbolTable& sym_table,
+                                       const uint32_t data_offset) const {
+    // pass1 turned the constants into decimal, so anything else is a label
+    const auto& value = literal_pool_[index];
+    if (!relocations_ && !std::isdigit(static_cast<unsigned char>(value[0])) && !sym_table.exists(value)) {
+        throw std::runtime_error("Unresolved label in literal =" + value + " at line " +
+                                 std::to_string(literal_lines_[index]));
+    }
+    return encode_word(value, sym_table, data_offset);
+}
+
+void CodeGenerator::copy_contents(const DirectiveNode* dir, std::vector<uint8_t>& buffer, const size_t pos) const {
+    const auto* bytes = dir->contents->data();
+    const auto size = dir->contents->size();
+    if (!dir->byteswap) {
+        std::copy_n(bytes, size, buffer.begin() + static_cast<long>(pos));
+        return;
+    }
+    // little-endian words, the last one zero-padded
+    for (size_t i = 0; i < dir->size; ++i) {
+        const auto src = (i & ~size_t{3}) + 3 - (i & 3);
+        buffer[pos + i] = src < size ? bytes[src] : 0;
     }
 }
 
-void CodeGenerator::write_uint32(std::vector<uint8_t>& buffer, const size_t pos, const uint32_t value) const {
-    // big-endian
-    buffer[pos + 0] = (value >> 24) & 0xFF;
-    buffer[pos + 1] = (value >> 16) & 0xFF;
-    buffer[pos + 2] = (value >> 8) & 0xFF;
-    buffer[pos + 3] = value & 0xFF;
+bool CodeGenerator::relocate(
+    const std::string& symbol, const SymbolTable& sym_table, const RelocationType type,
+    const Section section, const uint32_t offset
+) const {
+    if (!relocations_) return false;
+    // a branch inside the section keeps its offset wherever the linker puts it
+    if (type == RelocationType::BRANCH16 && sym_table.section(symbol) == section) return false;
+    relocations_->push_back({section, type, offset, symbol});
+    return true;
 }
\ No newline at end of file
@@ -13,18 +13,70 @@ struct BinaryOutput {
     std::vector<uint8_t> data;
 };
 
+enum class RelocationType : uint8_t {
+    BRANCH16, // beq/bne: word offset from the next instruction
+    ABS16,    // lw/sw/addi/slti: sign-extended address
+    ABS16U,   // andi/ori: zero-extended address
+    JUMP26,   // j/jal: word index inside the 256 MB region of the next instruction
+    ABS32     // .word values and literal pool entries
+};
+
+// a field left zero for the linker, which knows where every symbol ends up
+struct Relocation {
+    Section section;
+    RelocationType type;
+    uint32_t offset; // of the word to patch, inside its section
+    std::string symbol;
+};
+
+// receives each section's final bytes in address order while pass2 is still
+// encoding the rest, so later stages can start on them
+class EncodeListener {
+public:
+    virtual ~EncodeListener() = default;
+    virtual void encoded(Section section, const uint8_t* bytes, size_t size) = 0;
+};
+
 class CodeGenerator {
 public:
-    SymbolTable pass1(const AST& ast);
-    BinaryOutput pass2(const AST& ast, const SymbolTable& sym_table);
+    explicit CodeGenerator(TargetCore core = TargetCore::CLASSIC);
+
+    // assigns every node its section and address, rewrites each lw =value to the
+    // pool entry its value is keyed by and maps the .incbin files, then returns the labels
+    SymbolTable pass1(AST& ast);
+    // with relocations set, symbol addresses the linker may still move are recorded there
+    // instead of encoded, and labels this source does not define are allowed;
+    // with a listener set, the sections are handed to it in chunks as they are done
+    BinaryOutput pass2(const AST& ast, const SymbolTable& sym_table, std::vector<Relocation>* relocations = nullptr,
+                       EncodeListener* listener = nullptr);
+
+    // the checks pass1 applies to an instruction placed in the given section
+    void check_instruction(const Node* node, Section section) const;
+    // machine code of an instruction at the address pass1 assigned to it
+    uint32_t encode_instruction(const Node* node, const SymbolTable& sym_table) const;
+    // symbol is the interned val, if the caller has it
+    uint32_t encode_word(const std::string& val, const SymbolTable& sym_table, uint32_t data_offset = 0,
+                         uint32_t symbol = NO_SYMBOL) const;
+    // the file of an .incbin that pass1 mapped, byteswapped if asked, from pos on
+    void copy_contents(const DirectiveNode* dir, std::vector<uint8_t>& buffer, size_t pos) const;
+    // literal pool entry index, an unresolved label reported at the lw that asked for it
+    uint32_t encode_literal(size_t index, const SymbolTable& sym_table, uint32_t data_offset = 0) const;
+    [[nodiscard]] const std::vector<std::string>& literal_pool() const { return literal_pool_; }
 
 private:
     uint32_t get_reg_num(const std::string& reg) const;
     uint32_t encode_r(const RTypeInst* inst) const;
     uint32_t encode_i(const ITypeInst* inst, uint32_t current_addr, const SymbolTable& sym_table) const;
-    uint32_t encode_word(const std::string& val, const SymbolTable& sym_table) const;
-    // in big-endian
-    void write_uint32(std::vector<uint8_t>& buffer, size_t pos, uint32_t value) const;
+    uint32_t encode_j(const JTypeInst* inst, uint32_t current_addr, const SymbolTable& sym_table) const;
+    // true if the reference went to the relocations instead
+    bool relocate(const std::string& symbol, const SymbolTable& sym_table, RelocationType type,
+                  Section section, uint32_t offset) const;
+
+    TargetCore core_;
+    std::vector<Relocation>* relocations_ = nullptr; // set during a relocatable pass2
+    // values of the lw rt, =value operands, deduplicated; appended to the data section
+    std::vector<std::string> literal_pool_;
+    std::vector<int> literal_lines_; // of the first lw that uses each entry
 };
 
 #endif // CODE_GEN_H
\ No newline at end of file
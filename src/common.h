@@ -3,8 +3,11 @@
 
 
 #include <string>
+#include <string_view>
 #include <optional>
 #include <cstdint>
+#include <iterator>
+#include <utility>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -20,13 +23,19 @@ enum class TokenType {
     COLON,
     LPAREN,
     RPAREN,
+    EQUALS,
+    STRING,
     ILLEGAL
 };
 
+// ID of a name that was not interned (see interner.h)
+inline constexpr uint32_t NO_SYMBOL = UINT32_MAX;
+
 struct Token {
     TokenType type;
     std::string literal;
     int line;
+    uint32_t symbol = NO_SYMBOL; // interned name of an IDENT
 };
 
 enum class NodeType {
@@ -46,22 +55,43 @@ struct Node {
     std::optional<std::string> label_name;
     uint32_t address = 0;
     Section section = Section::TEXT;
+    int line = 0;     // source line the statement starts on
+    int end_line = 0; // and the line of its last token
     virtual ~Node() = default;
 };
 
+enum class TargetCore {
+    CLASSIC, // the original core: R-type, lw, sw, beq
+    EXTENDED // adds j, jal, bne, addi, slt, slti, andi, ori
+};
+
 inline const std::unordered_set<std::string_view> RTYPE_INSTRUCTIONS {
-    "mult","add","sub","sll","srl","and","or","not"
+    "mult","add","sub","sll","srl","and","or","not","slt"
 };
 
-inline const std::unordered_set<std::string_view> ITYPE_INSTRUCTIONS { "lw","sw","beq" };
+inline const std::unordered_set<std::string_view> ITYPE_INSTRUCTIONS {
+    "lw","sw","beq","bne","addi","slti","andi","ori"
+};
+
+inline const std::unordered_set<std::string_view> JTYPE_INSTRUCTIONS { "j","jal" };
 
 inline const std::unordered_set<std::string_view> INSTRUCTIONS = [] {
     std::unordered_set<std::string_view> s;
     s.insert(RTYPE_INSTRUCTIONS.begin(), RTYPE_INSTRUCTIONS.end());
     s.insert(ITYPE_INSTRUCTIONS.begin(), ITYPE_INSTRUCTIONS.end());
+    s.insert(JTYPE_INSTRUCTIONS.begin(), JTYPE_INSTRUCTIONS.end());
     return s;
 }();
 
+// not implemented by TargetCore::CLASSIC
+inline constexpr std::string_view EXTENDED_MNEMONICS[] = {
+    "slt","bne","addi","slti","andi","ori","j","jal"
+};
+
+inline const std::unordered_set<std::string_view> EXTENDED_INSTRUCTIONS(
+    std::begin(EXTENDED_MNEMONICS), std::end(EXTENDED_MNEMONICS)
+);
+
 inline const std::unordered_set<std::string_view> REGISTERS {
     "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7",
     "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
@@ -69,7 +99,15 @@ inline const std::unordered_set<std::string_view> REGISTERS {
     "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7"
 };
 
-const std::unordered_map<std::string_view, uint32_t> FUNCT_CODES = {
+// virtual registers (v0, v1, ...) are mapped onto physical ones before encoding
+constexpr bool is_virtual_register(const std::string_view reg) {
+    return reg.size() > 1 && reg[0] == 'v' &&
+           reg.find_first_not_of("0123456789", 1) == std::string_view::npos;
+}
+
+// the encodings as constant tables, which the compile-time assembler (static_assembler.h)
+// searches directly; the maps below are built from them
+inline constexpr std::pair<std::string_view, uint32_t> FUNCT_TABLE[] = {
     {"mult", 0x18},
     {"add", 0x20},
     {"sub", 0x22},
@@ -78,21 +116,35 @@ const std::unordered_map<std::string_view, uint32_t> FUNCT_CODES = {
     {"and", 0x24},
     {"or", 0x25},
     {"not", 0x27},
+    {"slt", 0x2A},
 };
 
-const std::unordered_map<std::string_view, uint32_t> OPCODES = {
+inline constexpr std::pair<std::string_view, uint32_t> OPCODE_TABLE[] = {
     {"lw", 0x23},
     {"sw", 0x2B},
-    {"beq", 0x04}
+    {"beq", 0x04},
+    {"bne", 0x05},
+    {"addi", 0x08},
+    {"slti", 0x0A},
+    {"andi", 0x0C},
+    {"ori", 0x0D},
+    {"j", 0x02},
+    {"jal", 0x03}
 };
 
-const std::unordered_map<std::string_view, uint32_t> REG_MAP = {
+inline constexpr std::pair<std::string_view, uint32_t> REGISTER_TABLE[] = {
     {"a0", 0}, {"a1", 1}, {"a2", 2}, {"a3", 3}, {"a4", 4}, {"a5", 5}, {"a6", 6}, {"a7", 7},
     {"r0", 8}, {"r1", 9}, {"r2", 10}, {"r3", 11}, {"r4", 12}, {"r5", 13}, {"r6", 14}, {"r7", 15},
     {"s0", 16}, {"s1", 17}, {"s2", 18}, {"s3", 19}, {"s4", 20}, {"s5", 21}, {"s6", 22}, {"s7", 23},
     {"t0", 24}, {"t1", 25}, {"t2", 26}, {"t3", 27}, {"t4", 28}, {"t5", 29}, {"t6", 30}, {"t7", 31}
 };
 
+const std::unordered_map<std::string_view, uint32_t> FUNCT_CODES(std::begin(FUNCT_TABLE), std::end(FUNCT_TABLE));
+
+const std::unordered_map<std::string_view, uint32_t> OPCODES(std::begin(OPCODE_TABLE), std::end(OPCODE_TABLE));
+
+const std::unordered_map<std::string_view, uint32_t> REG_MAP(std::begin(REGISTER_TABLE), std::end(REGISTER_TABLE));
+
 // the assembler will output to the files, in lines that starts (whitespace is allowed) with "###"
 constexpr std::string_view subs_token = "###";
 
@@ -0,0 +1,184 @@
+#include "dead_code.h"
+#include "cfg.h"
+
+#include <cctype>
+#include <unordered_map>
+
+
+namespace {
+
+bool is_number(const std::string& value) {
+    return !value.empty() && (std::isdigit(static_cast<unsigned char>(value[0])) || value[0] == '-');
+}
+
+bool is_memory_access(const ITypeInst* inst) {
+    return inst->mnemonic == "lw" || inst->mnemonic == "sw";
+}
+
+// lw/sw with a numeric offset depend on the exact data layout: whatever the base
+// register, a0 or r0 (which read as zero) included, it can point at any word
+bool is_absolute_access(const ITypeInst* inst) {
+    return is_memory_access(inst) && !inst->is_label_ref && !inst->is_literal;
+}
+
+}
+
+DeadCodeReport eliminate_dead_code(AST& ast) {
+    const ControlFlowGraph cfg(ast);
+    const auto& blocks = cfg.blocks();
+    DeadCodeReport report;
+
+    // split .data into regions, each starting at a label
+    std::vector<std::vector<size_t>> regions;
+    std::unordered_map<std::string, size_t> label_regions;
+    auto region_has_words = true;
+    for (const auto idx : cfg.data_nodes()) {
+        const auto* node = ast.nodes[idx].get();
+        if (regions.empty() || (node->type == NodeType::LABEL && region_has_words)) {
+            regions.emplace_back();
+            region_has_words = false;
+        }
+        regions.back().push_back(idx);
+        if (node->type == NodeType::LABEL) {
+            label_regions[dynamic_cast<const LabelNode*>(node)->name] = regions.size() - 1;
+        } else {
+            region_has_words = true;
+        }
+    }
+
+    std::vector<bool> live_blocks(blocks.size(), false);
+    std::vector<bool> live_regions(regions.size(), false);
+    std::vector<size_t> block_work;
+    std::vector<size_t> region_work;
+
+    auto mark_block = [&](const size_t id) {
+        if (!live_blocks[id]) {
+            live_blocks[id] = true;
+            block_work.push_back(id);
+        }
+    };
+    auto mark_region = [&](const size_t id) {
+        if (!live_regions[id]) {
+            live_regions[id] = true;
+            region_work.push_back(id);
+        }
+    };
+    auto mark_label = [&](const std::string& name) {
+        if (const auto block = cfg.block_of(name)) {
+            mark_block(*block);
+        } else if (const auto it = label_regions.find(name); it != label_regions.end()) {
+            mark_region(it->second);
+        }
+    };
+
+    if (!blocks.empty()) mark_block(0);
+    // a jump to a number may land anywhere, and removing code would move where it lands
+    if (cfg.has_address_targets()) {
+        report.text_pinned = true;
+        for (size_t id = 0; id < blocks.size(); ++id) mark_block(id);
+    }
+    // exported labels are entry points for whatever links against this source
+    for (const auto idx : cfg.symbol_directives()) {
+        for (const auto& name : dynamic_cast<const DirectiveNode*>(ast.nodes[idx].get())->values) mark_label(name);
+    }
+
+    // words ahead of the first data label can only be reached by address
+    if (!regions.empty() && ast.nodes[regions.front().front()]->type != NodeType::LABEL) {
+        mark_region(0);
+    }
+
+    for (const auto& block : blocks) {
+        for (const auto idx : block.nodes) {
+            const auto* inst = dynamic_cast<const ITypeInst*>(ast.nodes[idx].get());
+            if (inst && is_absolute_access(inst)) report.data_pinned = true;
+        }
+    }
+    if (report.data_pinned) {
+        for (size_t id = 0; id < regions.size(); ++id) mark_region(id);
+    }
+
+    while (!block_work.empty() || !region_work.empty()) {
+        if (!block_work.empty()) {
+            const auto& block = blocks[block_work.back()];
+            block_work.pop_back();
+
+            for (const auto idx : block.nodes) {
+                const auto* inst = dynamic_cast<const ITypeInst*>(ast.nodes[idx].get());
+                if (inst && inst->is_literal) {
+                    const auto value = inst->imm_or_label.substr(1);
+                    if (!is_number(value)) mark_label(value);
+                } else if (inst && inst->is_label_ref && !is_branch(inst)) {
+                    mark_label(inst->imm_or_label);
+                }
+            }
+            if (block.taken) mark_block(*block.taken);
+            if (block.fall_through) mark_block(*block.fall_through);
+        } else {
+            const auto& region = regions[region_work.back()];
+            region_work.pop_back();
+
+            for (const auto idx : region) {
+                const auto* dir = dynamic_cast<const DirectiveNode*>(ast.nodes[idx].get());
+                if (!dir || dir->name != "word") continue;
+                for (const auto& value : dir->values) {
+                    if (!is_number(value)) mark_label(value);
+                }
+            }
+        }
+    }
+
+    std::vector<bool> dead(ast.nodes.size(), false);
+    auto drop = [&](const size_t idx) {
+        const auto* node = ast.nodes[idx].get();
+        dead[idx] = true;
+        if (node->type == NodeType::LABEL) {
+            report.labels.push_back(dynamic_cast<const LabelNode*>(node)->name);
+        } else if (node->type == NodeType::INSTRUCTION) {
+            report.instruction_lines.push_back(node->line);
+        } else if (const auto* dir = dynamic_cast<const DirectiveNode*>(node)) {
+            report.data_words += dir->data_size() / 4;
+        }
+    };
+
+    for (size_t id = 0; id < blocks.size(); ++id) {
+        if (!live_blocks[id]) {
+            for (const auto idx : blocks[id].nodes) drop(idx);
+        }
+    }
+    for (size_t id = 0; id < regions.size(); ++id) {
+        if (!live_regions[id]) {
+            for (const auto idx : regions[id]) drop(idx);
+        }
+    }
+
+    std::vector<std::unique_ptr<Node>> kept;
+    kept.reserve(ast.nodes.size());
+    for (size_t idx = 0; idx < ast.nodes.size(); ++idx) {
+        if (!dead[idx]) kept.push_back(std::move(ast.nodes[idx]));
+    }
+    ast.nodes = std::move(kept);
+
+    return report;
+}
+
+void print_report(std::ostream& out, const DeadCodeReport& report) {
+    out << "Dead code elimination: removed " << report.instruction_lines.size()
+        << " unreachable instruction(s), " << report.data_words << " unreferenced .word value(s)\n";
+
+    if (!report.instruction_lines.empty()) {
+        out << "  instructions at line(s):";
+        for (const auto line : report.instruction_lines) out << ' ' << line;
+        out << '\n';
+    }
+    if (!report.labels.empty()) {
+        out << "  labels:";
+        for (const auto& label : report.labels) out << ' ' << label;
+        out << '\n';
+    }
+    if (report.text_pinned) {
+        out << "  .text kept as is: the program branches to numeric addresses\n";
+    }
+    if (report.data_pinned) {
+        out << "  .data kept as is: the program uses lw/sw with numeric addresses\n";
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef DEAD_CODE_H
+#define DEAD_CODE_H
+
+
+#include "parser.h"
+
+#include <ostream>
+#include <vector>
+
+
+struct DeadCodeReport {
+    std::vector<int> instruction_lines; // source lines of the removed instructions
+    std::vector<std::string> labels;    // removed labels
+    size_t data_words = 0;              // removed .word values
+    bool data_pinned = false;           // numeric lw/sw addresses kept the whole data section
+    bool text_pinned = false;           // numeric branch targets kept the whole text section
+};
+
+// removes the .text blocks unreachable from the entry point and the .data
+// regions (a label and the words up to the next label) nobody refers to
+DeadCodeReport eliminate_dead_code(AST& ast);
+
+void print_report(std::ostream& out, const DeadCodeReport& report);
+
+#endif // DEAD_CODE_H
@@ -0,0 +1,179 @@
+#include "hot_spots.h"
+#include "mapped_file.h"
+#include "scan.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace {
+
+constexpr auto NOT_HEX = std::numeric_limits<uint8_t>::max();
+
+constexpr std::array<uint8_t, 256> HEX_VALUES = [] {
+    std::array<uint8_t, 256> values{};
+    values.fill(NOT_HEX);
+    for (int c = '0'; c <= '9'; ++c) values[c] = static_cast<uint8_t>(c - '0');
+    for (int c = 'a'; c <= 'f'; ++c) values[c] = static_cast<uint8_t>(c - 'a' + 10);
+    for (int c = 'A'; c <= 'F'; ++c) values[c] = static_cast<uint8_t>(c - 'A' + 10);
+    return values;
+}();
+
+struct BlockStats {
+    uint64_t instructions = 0;
+    uint64_t executions = 0; // of the first instruction
+    size_t first_word = 0;
+    size_t last_word = 0;
+    int first_line = 0;
+    int last_line = 0;
+    uint32_t label = 0;
+    bool seen = false;
+};
+
+// indices of the non-zero counts, the top ones first; ties keep the lower index first
+std::vector<size_t> top_indices(const std::vector<uint64_t>& counts, const size_t top) {
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] > 0) indices.push_back(i);
+    }
+    const auto shown = std::min(top, indices.size());
+    std::partial_sort(indices.begin(), indices.begin() + static_cast<long>(shown), indices.end(),
+                      [&](const size_t a, const size_t b) { return counts[a] != counts[b] ? counts[a] > counts[b] : a < b; });
+    indices.resize(shown);
+    return indices;
+}
+
+std::string percent(const uint64_t count, const uint64_t total) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2) << (total ? 100.0 * static_cast<double>(count) / static_cast<double>(total) : 0.0)
+        << '%';
+    return out.str();
+}
+
+std::string hex_address(const size_t word) {
+    std::ostringstream out;
+    out << "0x" << std::hex << std::setw(8) << std::setfill('0') << 4 * word;
+    return out.str();
+}
+
+std::string source_text(const std::vector<std::string>* source, const int line) {
+    if (!source || line <= 0 || static_cast<size_t>(line) > source->size()) return "";
+    const auto& text = (*source)[line - 1];
+    const auto begin = text.find_first_not_of(" \t");
+    return begin == std::string::npos ? "" : text.substr(begin);
+}
+
+}
+
+TraceCounts count_trace(const std::string& path, const size_t words) {
+    std::unique_ptr<MappedFile> file;
+    try {
+        file = std::make_unique<MappedFile>(path);
+    } catch (const std::exception&) {
+        throw std::runtime_error("Failed to open trace file: " + path);
+    }
+    const auto* data = reinterpret_cast<const char*>(file->data());
+    const auto size = file->size();
+
+    TraceCounts counts;
+    counts.words.assign(words, 0);
+    // the separators are a byte or two, too short to be worth the block-wise scan
+    const auto skip_space = [&](size_t pos) {
+        while (pos < size && (data[pos] == '\n' || data[pos] == ' ' || data[pos] == '\r' || data[pos] == '\t')) ++pos;
+        return pos;
+    };
+    auto pos = skip_space(0);
+    while (pos < size) {
+        const auto start = pos;
+        if (data[pos] == '0' && pos + 1 < size && (data[pos + 1] | 0x20) == 'x') pos += 2;
+        uint64_t pc = 0;
+        const auto digits_start = pos;
+        for (uint8_t value; pos < size && (value = HEX_VALUES[static_cast<unsigned char>(data[pos])]) != NOT_HEX; ++pos) {
+            pc = (pc << 4) | value;
+        }
+        const auto end = skip_space(pos);
+        if (pos == digits_start || pos - digits_start > 16 || (end == pos && pos < size)) {
+            // lines are only counted for the message
+            const auto line = 1 + scan::count_newlines(data, 0, start);
+            throw std::runtime_error("Malformed PC in trace at " + path + ":" + std::to_string(line));
+        }
+
+        ++counts.total;
+        if (pc % 4 == 0 && pc / 4 < words) {
+            ++counts.words[pc / 4];
+        } else {
+            ++counts.outside;
+        }
+        pos = end;
+    }
+    return counts;
+}
+
+void print_hot_spots(std::ostream& out, const SourceMap& map, const TraceCounts& counts, const size_t top,
+                     const std::vector<std::string>* source) {
+    const utils::StreamFormatGuard guard(out);
+
+    const auto executed = counts.total - counts.outside;
+    out << "Trace: " << counts.total << " PC(s), " << counts.outside
+        << " outside the mapped instructions\n";
+
+    // one pass over the histogram gathers the blocks and labels
+    std::vector<BlockStats> blocks;
+    std::vector<uint64_t> labels(map.labels.size(), 0);
+    for (size_t word = 0; word < map.entries.size(); ++word) {
+        const auto& entry = map.entries[word];
+        if (entry.line == 0) continue;
+        const auto count = counts.words[word];
+        labels[entry.label] += count;
+
+        if (entry.block >= blocks.size()) blocks.resize(entry.block + 1);
+        auto& block = blocks[entry.block];
+        if (!block.seen) {
+            block.seen = true;
+            block.executions = count;
+            block.first_word = word;
+            block.first_line = entry.line;
+            block.label = entry.label;
+        }
+        block.instructions += count;
+        block.last_word = word;
+        block.last_line = entry.line;
+    }
+
+    const auto hot_words = top_indices(counts.words, top);
+    out << "\nHot instructions\n" << std::right << std::setw(14) << "count" << std::setw(9) << "%" << std::setw(12)
+        << "address" << std::setw(8) << "line" << "  " << std::left << std::setw(20) << "label" << "source\n";
+    for (const auto word : hot_words) {
+        const auto& entry = map.entries[word];
+        out << std::right << std::setw(14) << counts.words[word] << std::setw(9) << percent(counts.words[word], executed)
+            << std::setw(12) << hex_address(word) << std::setw(8) << entry.line << "  " << std::left << std::setw(20)
+            << map.labels[entry.label] << source_text(source, entry.line) << "\n";
+    }
+
+    std::vector<uint64_t> block_instructions(blocks.size(), 0);
+    for (size_t id = 0; id < blocks.size(); ++id) block_instructions[id] = blocks[id].instructions;
+    out << "\nHot blocks\n" << std::right << std::setw(14) << "instructions" << std::setw(9) << "%" << std::setw(12)
+        << "executions" << std::setw(24) << "addresses" << std::setw(14) << "lines" << "  label\n";
+    for (const auto id : top_indices(block_instructions, top)) {
+        const auto& block = blocks[id];
+        const auto lines = block.first_line == block.last_line
+                               ? std::to_string(block.first_line)
+                               : std::to_string(block.first_line) + "-" + std::to_string(block.last_line);
+        out << std::setw(14) << block.instructions << std::setw(9) << percent(block.instructions, executed)
+            << std::setw(12) << block.executions << std::setw(24)
+            << hex_address(block.first_word) + "-" + hex_address(block.last_word) << std::setw(14) << lines << "  "
+            << map.labels[block.label] << "\n";
+    }
+
+    out << "\nHot labels\n" << std::setw(14) << "instructions" << std::setw(9) << "%" << "  label\n";
+    for (const auto label : top_indices(labels, top)) {
+        out << std::setw(14) << labels[label] << std::setw(9) << percent(labels[label], executed) << "  "
+            << map.labels[label] << "\n";
+    }
+}
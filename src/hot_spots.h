@@ -0,0 +1,29 @@
+#ifndef HOT_SPOTS_H
+#define HOT_SPOTS_H
+
+
+#include "source_map.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// executions per .text word, counted from a PC trace
+struct TraceCounts {
+    std::vector<uint64_t> words; // by address / 4, as many as the map has entries
+    uint64_t total = 0;          // PCs read
+    uint64_t outside = 0;        // of those, unaligned or past the last mapped instruction
+};
+
+// streams a trace of hexadecimal PCs ("0x" optional) separated by whitespace into
+// a flat histogram; the file is memory-mapped, so traces larger than memory work
+TraceCounts count_trace(const std::string& path, size_t words);
+
+// the top instructions, basic blocks and labels by instructions executed. source,
+// if given, holds the lines of the assembled file, quoted next to each instruction
+void print_hot_spots(std::ostream& out, const SourceMap& map, const TraceCounts& counts, size_t top,
+                     const std::vector<std::string>* source = nullptr);
+
+#endif // HOT_SPOTS_H
@@ -0,0 +1,74 @@
+#include "interner.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 64 * 1024;
+constexpr size_t INITIAL_SLOTS = 256; // a power of two
+
+// FNV-1a
+uint64_t hash_name(const std::string_view name) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const auto c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+}
+
+SymbolInterner::SymbolInterner() : slots_(INITIAL_SLOTS, NO_SYMBOL) {}
+
+uint32_t SymbolInterner::intern(const std::string_view name) {
+    const auto hash = hash_name(name);
+    auto slot = slot_of(name, hash);
+    if (slots_[slot] != NO_SYMBOL) return slots_[slot];
+
+    const auto id = static_cast<uint32_t>(names_.size());
+    names_.push_back(store(name));
+    hashes_.push_back(hash);
+    slots_[slot] = id;
+    // at most half full keeps the probe sequences short
+    if (2 * names_.size() > slots_.size()) grow();
+    return id;
+}
+
+uint32_t SymbolInterner::find(const std::string_view name) const {
+    return slots_[slot_of(name, hash_name(name))];
+}
+
+// the slot holding name, or the empty one where it would go
+size_t SymbolInterner::slot_of(const std::string_view name, const uint64_t hash) const {
+    const auto mask = slots_.size() - 1;
+    for (auto slot = hash & mask;; slot = (slot + 1) & mask) {
+        const auto id = slots_[slot];
+        if (id == NO_SYMBOL || (hashes_[id] == hash && names_[id] == name)) return slot;
+    }
+}
+
+std::string_view SymbolInterner::store(const std::string_view name) {
+    if (blocks_.empty() || block_size_ - block_used_ < name.size()) {
+        // a name longer than a block gets a block of its own
+        block_size_ = std::max(BLOCK_SIZE, name.size());
+        blocks_.push_back(std::make_unique<char[]>(block_size_));
+        block_used_ = 0;
+    }
+    auto* dest = blocks_.back().get() + block_used_;
+    std::memcpy(dest, name.data(), name.size());
+    block_used_ += name.size();
+    return {dest, name.size()};
+}
+
+void SymbolInterner::grow() {
+    slots_.assign(2 * slots_.size(), NO_SYMBOL);
+    const auto mask = slots_.size() - 1;
+    for (uint32_t id = 0; id < names_.size(); ++id) {
+        auto slot = hashes_[id] & mask;
+        while (slots_[slot] != NO_SYMBOL) slot = (slot + 1) & mask;
+        slots_[slot] = id;
+    }
+}
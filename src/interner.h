@@ -0,0 +1,44 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+
+#include "common.h"
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+
+// every distinct label name stored once and numbered densely from 0, so later
+// passes index flat tables with the ID instead of hashing the name again
+class SymbolInterner {
+public:
+    SymbolInterner();
+
+    SymbolInterner(const SymbolInterner&) = delete;
+    SymbolInterner& operator=(const SymbolInterner&) = delete;
+
+    // the ID of name, assigning the next one on first sight
+    uint32_t intern(std::string_view name);
+    // NO_SYMBOL for a name never interned
+    [[nodiscard]] uint32_t find(std::string_view name) const;
+    // stays valid as long as the interner
+    [[nodiscard]] std::string_view name(uint32_t id) const { return names_[id]; }
+    [[nodiscard]] size_t size() const { return names_.size(); }
+
+private:
+    [[nodiscard]] size_t slot_of(std::string_view name, uint64_t hash) const;
+    std::string_view store(std::string_view name);
+    void grow();
+
+    // names are copied into fixed blocks that never move
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    size_t block_used_ = 0;
+    size_t block_size_ = 0;
+
+    std::vector<std::string_view> names_; // by ID
+    std::vector<uint64_t> hashes_;        // by ID, for rehashing without touching the names
+    std::vector<uint32_t> slots_;         // open addressing with linear probing: IDs or NO_SYMBOL
+};
+
+#endif // INTERNER_H
@@ -0,0 +1,309 @@
+#include "layout.h"
+#include "cfg.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+
+namespace {
+
+struct Edge {
+    size_t from;
+    size_t to;
+    double weight;
+    bool placeable;         // false for a taken branch that cannot be inverted
+};
+
+constexpr double BACKWARD_TAKEN = 0.9;
+constexpr double FORWARD_TAKEN = 0.4;
+constexpr double LOOP_SCALE = 8.0;
+constexpr int MAX_LOOP_DEPTH = 6;
+
+std::vector<double> estimate_frequencies(const ControlFlowGraph& cfg, const AST& ast, const BlockProfile* profile) {
+    const auto& blocks = cfg.blocks();
+    std::vector<double> freq(blocks.size(), 0.0);
+
+    if (profile) {
+        auto lookup = [&](const std::string& key) -> std::optional<uint64_t> {
+            const auto it = profile->find(key);
+            if (it != profile->end()) return it->second;
+            return std::nullopt;
+        };
+        for (size_t id = 0; id < blocks.size(); ++id) {
+            auto count = lookup(std::to_string(ast.nodes[blocks[id].nodes.front()]->line));
+            for (const auto& label : blocks[id].labels) {
+                if (count) break;
+                count = lookup(label);
+            }
+            freq[id] = count ? static_cast<double>(*count) : 0.0;
+        }
+        return freq;
+    }
+
+    // no profile: every backward branch closes a loop over the blocks in between
+    std::vector<int> depth(blocks.size(), 0);
+    for (size_t id = 0; id < blocks.size(); ++id) {
+        const auto& taken = blocks[id].taken;
+        if (taken && *taken <= id) {
+            for (auto inner = *taken; inner <= id; ++inner) depth[inner]++;
+        }
+    }
+    for (size_t id = 0; id < blocks.size(); ++id) {
+        freq[id] = std::pow(LOOP_SCALE, std::min(depth[id], MAX_LOOP_DEPTH));
+    }
+    return freq;
+}
+
+double taken_probability(const ControlFlowGraph& cfg, const size_t id, const std::vector<double>& freq, const bool profiled) {
+    const auto& block = cfg.blocks()[id];
+    if (!block.branch || !block.taken) return 0.0;
+    if (is_unconditional_branch(block.branch)) return 1.0;
+
+    if (profiled && block.fall_through) {
+        const auto taken = freq[*block.taken];
+        const auto fall = freq[*block.fall_through];
+        if (taken + fall > 0.0) return taken / (taken + fall);
+    }
+    return *block.taken <= id ? BACKWARD_TAKEN : FORWARD_TAKEN;
+}
+
+// a block holding nothing but its jump gains nothing from moving when it is fallen into:
+// the jump it drops reappears in the predecessor
+bool is_trampoline(const ControlFlowGraph& cfg, const AST& ast, const size_t id) {
+    const auto& block = cfg.blocks()[id];
+    if (!block.branch || !is_unconditional_branch(block.branch)) return false;
+
+    for (const auto idx : block.nodes) {
+        const auto* node = ast.nodes[idx].get();
+        if (node != block.branch && node->type != NodeType::LABEL) return false;
+    }
+    return std::ranges::any_of(block.preds, [&](const size_t pred) {
+        return cfg.blocks()[pred].fall_through == id;
+    });
+}
+
+std::optional<std::string> inverse_branch(const Node* branch, const TargetCore core) {
+    if (core == TargetCore::CLASSIC) return std::nullopt;
+    const auto* inst = dynamic_cast<const ITypeInst*>(branch);
+    if (!inst) return std::nullopt;
+    if (inst->mnemonic == "beq") return "bne";
+    if (inst->mnemonic == "bne") return "beq";
+    return std::nullopt;
+}
+
+std::unique_ptr<ITypeInst> make_jump(const std::string& label, SymbolInterner& symbols, const int line) {
+    auto jump = std::make_unique<ITypeInst>();
+    jump->mnemonic = "beq";
+    jump->rs = "r0";
+    jump->rt = "r0";
+    jump->set_label(label, symbols);
+    jump->line = line;
+    return jump;
+}
+
+}
+
+BlockProfile load_block_profile(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Failed to open profile file: " + path);
+
+    BlockProfile profile;
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        ++line_no;
+        if (const auto comment = line.find_first_of(";#"); comment != std::string::npos) {
+            line.erase(comment);
+        }
+        std::istringstream fields(line);
+        std::string key;
+        uint64_t count;
+        if (!(fields >> key)) continue;
+        if (!(fields >> count)) {
+            throw std::runtime_error("Malformed profile entry at " + path + ":" + std::to_string(line_no));
+        }
+        profile[key] += count;
+    }
+    return profile;
+}
+
+LayoutReport optimize_layout(AST& ast, const TargetCore core, const BlockProfile* profile) {
+    const ControlFlowGraph cfg(ast);
+    const auto& blocks = cfg.blocks();
+    LayoutReport report;
+    if (blocks.empty()) return report;
+    // moving a block would change what a numeric target points at
+    if (cfg.has_address_targets()) {
+        report.pinned = true;
+        return report;
+    }
+
+    const auto freq = estimate_frequencies(cfg, ast, profile);
+
+    std::vector<Edge> edges;
+    for (size_t id = 0; id < blocks.size(); ++id) {
+        const auto& block = blocks[id];
+        const auto p = taken_probability(cfg, id, freq, profile != nullptr);
+        if (block.taken && !is_trampoline(cfg, ast, id)) {
+            const auto placeable = is_unconditional_branch(block.branch) ||
+                                   (block.fall_through && inverse_branch(block.branch, core));
+            edges.push_back({id, *block.taken, freq[id] * p, placeable});
+        }
+        if (block.fall_through) {
+            edges.push_back({id, *block.fall_through, freq[id] * (1.0 - p), true});
+        }
+    }
+    // ties keep program order, so an unprofiled straight-line program stays as written
+    std::stable_sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+        return a.weight > b.weight;
+    });
+
+    // the last block may run off the end of the program, so it has to stay last
+    const auto& last = blocks.back();
+    std::optional<size_t> runs_off_end;
+    if (!last.branch || !is_unconditional_branch(last.branch)) runs_off_end = blocks.size() - 1;
+
+    std::vector<std::vector<size_t>> chains(blocks.size());
+    std::vector<size_t> chain_of(blocks.size());
+    for (size_t id = 0; id < blocks.size(); ++id) {
+        chains[id] = {id};
+        chain_of[id] = id;
+    }
+
+    for (const auto& edge : edges) {
+        if (!edge.placeable || edge.to == 0 || edge.from == runs_off_end) continue;
+
+        const auto src = chain_of[edge.from];
+        const auto dst = chain_of[edge.to];
+        if (src == dst || chains[src].back() != edge.from || chains[dst].front() != edge.to) continue;
+
+        // the entry chain goes first: it cannot also swallow the block that must go last
+        if (runs_off_end && chains[src].size() + chains[dst].size() < blocks.size()) {
+            const auto has_entry = chain_of[0] == src || chain_of[0] == dst;
+            const auto has_end = chain_of[*runs_off_end] == src || chain_of[*runs_off_end] == dst;
+            if (has_entry && has_end) continue;
+        }
+
+        for (const auto id : chains[dst]) chain_of[id] = src;
+        chains[src].insert(chains[src].end(), chains[dst].begin(), chains[dst].end());
+        chains[dst].clear();
+    }
+
+    std::vector<size_t> order = chains[chain_of[0]];
+    std::optional<size_t> end_chain;
+    if (runs_off_end) end_chain = chain_of[*runs_off_end];
+    for (size_t head = 0; head < blocks.size(); ++head) {
+        const auto chain = chain_of[head];
+        if (chains[chain].empty() || chains[chain].front() != head) continue;
+        if (chain == chain_of[0] || chain == end_chain) continue;
+        order.insert(order.end(), chains[chain].begin(), chains[chain].end());
+    }
+    if (end_chain && *end_chain != chain_of[0]) {
+        order.insert(order.end(), chains[*end_chain].begin(), chains[*end_chain].end());
+    }
+
+    // decide how every block reaches its successors in the new order
+    std::vector<bool> drop_branch(blocks.size(), false);
+    std::vector<std::optional<size_t>> jump_to(blocks.size());
+    std::vector<bool> invert(blocks.size(), false);
+    std::vector<bool> needs_label(blocks.size(), false);
+
+    for (size_t pos = 0; pos < order.size(); ++pos) {
+        const auto id = order[pos];
+        const auto& block = blocks[id];
+        std::optional<size_t> next;
+        if (pos + 1 < order.size()) next = order[pos + 1];
+
+        if (id != pos) report.blocks_moved++;
+
+        if (block.branch && is_unconditional_branch(block.branch)) {
+            if (block.taken && block.taken == next) {
+                drop_branch[id] = true;
+                report.jumps_removed++;
+            }
+        } else if (block.fall_through && block.fall_through != next) {
+            needs_label[*block.fall_through] = true;
+            if (block.taken == next && inverse_branch(block.branch, core)) {
+                invert[id] = true;
+                report.branches_inverted++;
+            } else {
+                jump_to[id] = block.fall_through;
+                report.jumps_added++;
+            }
+        }
+    }
+
+    std::unordered_set<std::string> names;
+    for (const auto& block : blocks) names.insert(block.labels.begin(), block.labels.end());
+    for (const auto idx : cfg.data_nodes()) {
+        if (const auto* label = dynamic_cast<const LabelNode*>(ast.nodes[idx].get())) names.insert(label->name);
+    }
+
+    std::vector<std::string> block_labels(blocks.size());
+    size_t next_label = 0;
+    for (size_t id = 0; id < blocks.size(); ++id) {
+        if (!blocks[id].labels.empty()) {
+            block_labels[id] = blocks[id].labels.front();
+        } else if (needs_label[id]) {
+            do {
+                block_labels[id] = "__L" + std::to_string(next_label++);
+            } while (names.contains(block_labels[id]));
+        }
+    }
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    nodes.reserve(ast.nodes.size() + report.jumps_added + 2);
+
+    for (const auto idx : cfg.symbol_directives()) nodes.push_back(std::move(ast.nodes[idx]));
+
+    auto text_dir = std::make_unique<DirectiveNode>();
+    text_dir->name = "text";
+    nodes.push_back(std::move(text_dir));
+
+    for (const auto id : order) {
+        const auto& block = blocks[id];
+        if (block.labels.empty() && needs_label[id]) {
+            auto label = std::make_unique<LabelNode>();
+            label->set_name(block_labels[id], *ast.symbols);
+            label->line = ast.nodes[block.nodes.front()]->line;
+            nodes.push_back(std::move(label));
+        }
+        for (const auto idx : block.nodes) {
+            if (ast.nodes[idx].get() == block.branch) {
+                if (drop_branch[id]) continue;
+                if (invert[id]) {
+                    // branch to the old fall-through on the opposite condition
+                    auto* inst = dynamic_cast<ITypeInst*>(ast.nodes[idx].get());
+                    inst->mnemonic = *inverse_branch(inst, core);
+                    inst->set_label(block_labels[*block.fall_through], *ast.symbols);
+                }
+            }
+            nodes.push_back(std::move(ast.nodes[idx]));
+        }
+        if (jump_to[id]) {
+            const auto& target = block_labels[*jump_to[id]];
+            nodes.push_back(make_jump(target, *ast.symbols, nodes.back()->line));
+        }
+    }
+
+    if (!cfg.data_nodes().empty()) {
+        auto data_dir = std::make_unique<DirectiveNode>();
+        data_dir->name = "data";
+        nodes.push_back(std::move(data_dir));
+        for (const auto idx : cfg.data_nodes()) nodes.push_back(std::move(ast.nodes[idx]));
+    }
+
+    ast.nodes = std::move(nodes);
+    return report;
+}
+
+void print_report(std::ostream& out, const LayoutReport& report) {
+    out << "Block layout: moved " << report.blocks_moved << " block(s), removed "
+        << report.jumps_removed << " jump(s), added " << report.jumps_added << " jump(s), inverted "
+        << report.branches_inverted << " branch(es)\n";
+    if (report.pinned) out << "  blocks kept in place: the program branches to numeric addresses\n";
+}
@@ -0,0 +1,32 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+
+#include "parser.h"
+
+#include <ostream>
+#include <unordered_map>
+
+
+// execution counts keyed by a block's label, or by the source line of its first statement
+using BlockProfile = std::unordered_map<std::string, uint64_t>;
+
+struct LayoutReport {
+    size_t blocks_moved = 0;
+    size_t jumps_removed = 0;
+    size_t jumps_added = 0;
+    size_t branches_inverted = 0;
+    bool pinned = false; // numeric branch targets kept the original order
+};
+
+// reads "<label-or-line> <count>" lines; ';' and '#' start comments
+BlockProfile load_block_profile(const std::string& path);
+
+// reorders the .text blocks so the likely successor of each block follows it,
+// then adds or drops the beq r0, r0 jumps the new order needs. conditional
+// branches are only inverted (beq <-> bne) on cores that have bne
+LayoutReport optimize_layout(AST& ast, TargetCore core, const BlockProfile* profile = nullptr);
+
+void print_report(std::ostream& out, const LayoutReport& report);
+
+#endif // LAYOUT_H
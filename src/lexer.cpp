@@ -1,9 +1,13 @@
 #include "lexer.h"
+#include "scan.h"
+
+#include <algorithm>
 #include <cctype>
 
 
-Lexer::Lexer(const std::string& input)
-    : input_(input), pos_(0), line_(1), current_char_(input.empty() ? '\0' : input[0]) {}
+Lexer::Lexer(const std::string& input, std::shared_ptr<SymbolInterner> symbols, const TargetCore core)
+    : input_(input), pos_(0), line_(!input.empty() && input[0] == '\n' ? 2 : 1),
+      current_char_(input.empty() ? '\0' : input[0]), symbols_(std::move(symbols)), core_(core) {}
 
 void Lexer::advance() {
     if (pos_ + 1 < input_.size()) {
@@ -11,28 +15,32 @@ void Lexer::advance() {
         current_char_ = input_[pos_];
         if (current_char_ == '\n') line_++;
     } else {
+        pos_ = input_.size();
         current_char_ = '\0';
     }
 }
 
-void Lexer::skip_whitespace() {
-    while (current_char_ != '\0' && std::isspace(current_char_)) {
-        advance();
+void Lexer::move_to(const size_t pos) {
+    // like advance() one step at a time: the newline under pos_ is already counted
+    if (pos > pos_) {
+        line_ += static_cast<int>(scan::count_newlines(input_.data(), pos_ + 1, std::min(pos + 1, input_.size())));
     }
+    pos_ = pos;
+    current_char_ = pos < input_.size() ? input_[pos] : '\0';
+}
+
+void Lexer::skip_whitespace() {
+    move_to(scan::skip_space(input_.data(), pos_, input_.size()));
 }
 
 void Lexer::skip_comment() {
-    while (current_char_ != '\0' && current_char_ != '\n') {
-        advance();
-    }
+    move_to(scan::find_line_end(input_.data(), pos_, input_.size()));
 }
 
 std::string Lexer::read_ident() {
-    auto result = std::string{};
-    while (current_char_ != '\0' && (std::isalnum(current_char_) || current_char_ == '_')) {
-        result += current_char_;
-        advance();
-    }
+    const auto end = scan::skip_ident(input_.data(), pos_, input_.size());
+    auto result = input_.substr(pos_, end - pos_);
+    move_to(end);
     return result;
 }
 
@@ -59,75 +67,97 @@ std::string Lexer::read_number() {
 }
 
 bool Lexer::is_instruction(const std::string& s) const {
-    return INSTRUCTIONS.contains(s);
+    return INSTRUCTIONS.contains(s) && (core_ == TargetCore::EXTENDED || !EXTENDED_INSTRUCTIONS.contains(s));
 }
 
 bool Lexer::is_register(const std::string& s) const {
     auto reg = s;
     if (!reg.empty() && reg[0] == '$') reg = reg.substr(1);
-    return REGISTERS.contains(reg);
+    return REGISTERS.contains(reg) || is_virtual_register(reg);
 }
 
 Token Lexer::next_token() {
+    // a loop, not a call per comment: generated files can hold millions of comment lines
     skip_whitespace();
-
-    if (current_char_ == ';') {
+    while (current_char_ == ';') {
         skip_comment();
-        return next_token();
+        skip_whitespace();
     }
 
     if (current_char_ == '\0') {
         return {TokenType::EoF, "", line_};
     }
 
+    // reading a token may step onto the newline that ends its line
+    const auto line = line_;
+
     if (std::isalpha(current_char_) || current_char_ == '_') {
         auto ident = read_ident();
         if (is_instruction(ident)) {
-            return {TokenType::INST, ident, line_};
+            return {TokenType::INST, ident, line};
         }
-        return {TokenType::IDENT, ident, line_};
+        const auto symbol = symbols_->intern(ident);
+        return {TokenType::IDENT, std::move(ident), line, symbol};
     }
 
     if (std::isdigit(current_char_) || current_char_ == '-' || (current_char_ == '0' && std::tolower(input_[pos_ + 1]) == 'x')) {
-        return {TokenType::NUMBER, read_number(), line_};
+        return {TokenType::NUMBER, read_number(), line};
     }
 
     if (current_char_ == '$') {
         advance();
         const auto reg = read_ident();
         if (is_register(reg)) {
-            return {TokenType::REGISTER, "$" + reg, line_};
+            return {TokenType::REGISTER, "$" + reg, line};
         }
-        return {TokenType::ILLEGAL, "$" + reg, line_};
+        return {TokenType::ILLEGAL, "$" + reg, line};
     }
 
     if (current_char_ == '.') {
         advance();
-        return {TokenType::DOT, ".", line_};
+        return {TokenType::DOT, ".", line};
     }
 
     if (current_char_ == ',') {
         advance();
-        return {TokenType::COMMA, ",", line_};
+        return {TokenType::COMMA, ",", line};
     }
 
     if (current_char_ == ':') {
         advance();
-        return {TokenType::COLON, ":", line_};
+        return {TokenType::COLON, ":", line};
+    }
+
+    if (current_char_ == '=') {
+        advance();
+        return {TokenType::EQUALS, "=", line};
+    }
+
+    if (current_char_ == '"') {
+        // "..." up to the closing quote on the same line, without escapes
+        advance();
+        auto text = std::string{};
+        while (current_char_ != '"' && current_char_ != '\n' && current_char_ != '\0') {
+            text += current_char_;
+            advance();
+        }
+        if (current_char_ != '"') return {TokenType::ILLEGAL, "\"" + text, line};
+        advance();
+        return {TokenType::STRING, text, line};
     }
 
     if (current_char_ == '(') {
         advance();
-        return {TokenType::LPAREN, "(", line_};
+        return {TokenType::LPAREN, "(", line};
     }
 
     if (current_char_ == ')') {
         advance();
-        return {TokenType::RPAREN, ")", line_};
+        return {TokenType::RPAREN, ")", line};
     }
 
     // no match --> illegal
     const auto illegal = std::string(1, current_char_);
     advance();
-    return {TokenType::ILLEGAL, illegal, line_};
+    return {TokenType::ILLEGAL, illegal, line};
 }
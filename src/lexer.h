@@ -3,16 +3,45 @@
 
 
 #include "common.h"
+#include "interner.h"
 
+#include <memory>
 
-class Lexer {
+
+// an IDENT token under another name, with that name's ID
+inline Token renamed(Token token, std::string name, SymbolInterner& symbols) {
+    token.literal = std::move(name);
+    token.symbol = symbols.intern(token.literal);
+    return token;
+}
+
+// where the parser pulls its tokens from
+class TokenSource {
+public:
+    virtual ~TokenSource() = default;
+
+    // EoF once the input is exhausted, and on every call after that
+    virtual Token next_token() = 0;
+    // the table the symbols of the IDENT tokens index
+    [[nodiscard]] virtual const std::shared_ptr<SymbolInterner>& symbols() const = 0;
+};
+
+class Lexer final : public TokenSource {
 public:
-    explicit Lexer(const std::string& input);
+    // identifiers are interned into symbols, which may be shared with earlier lexers.
+    // On the classic core the extended mnemonics are identifiers, as labels may use them
+    explicit Lexer(const std::string& input,
+                   std::shared_ptr<SymbolInterner> symbols = std::make_shared<SymbolInterner>(),
+                   TargetCore core = TargetCore::CLASSIC);
 
-    Token next_token();
+    Token next_token() override;
+    [[nodiscard]] const std::shared_ptr<SymbolInterner>& symbols() const override { return symbols_; }
+    [[nodiscard]] TargetCore core() const { return core_; }
 
 private:
     void advance();
+    // jumps forward to pos, keeping the line count
+    void move_to(size_t pos);
     void skip_whitespace();
     void skip_comment();
     std::string read_ident();
@@ -24,6 +53,8 @@ private:
     size_t pos_;
     int line_;
     char current_char_;
+    std::shared_ptr<SymbolInterner> symbols_;
+    TargetCore core_;
 };
 
 #endif // LEXER_H
\ No newline at end of file
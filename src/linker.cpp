@@ -0,0 +1,87 @@
+#include "linker.h"
+#include "utils.h"
+
+#include <stdexcept>
+#include <unordered_map>
+
+
+namespace {
+
+// the relocated field of word, holding the final address of its symbol
+uint32_t patch(const uint32_t word, const Relocation& relocation, const uint32_t symbol_addr, const uint32_t place) {
+    switch (relocation.type) {
+        case RelocationType::BRANCH16: {
+            const auto offset = (static_cast<int64_t>(symbol_addr) - static_cast<int64_t>(place + 4)) / 4;
+            if (offset < -32768 || offset > 32767) {
+                throw std::runtime_error("Branch to " + relocation.symbol + " out of range");
+            }
+            return (word & 0xFFFF0000) | (static_cast<uint32_t>(offset) & 0xFFFF);
+        }
+        case RelocationType::ABS16:
+            if (symbol_addr > 32767) throw std::runtime_error("Immediate overflow: " + std::to_string(symbol_addr));
+            return (word & 0xFFFF0000) | symbol_addr;
+        case RelocationType::ABS16U:
+            if (symbol_addr > 65535) throw std::runtime_error("Immediate overflow: " + std::to_string(symbol_addr));
+            return (word & 0xFFFF0000) | symbol_addr;
+        case RelocationType::JUMP26:
+            if (symbol_addr % 4 != 0) throw std::runtime_error("Unaligned jump target: " + relocation.symbol);
+            if ((symbol_addr & 0xF0000000) != ((place + 4) & 0xF0000000)) {
+                throw std::runtime_error("Jump target out of range: " + relocation.symbol);
+            }
+            return (word & 0xFC000000) | ((symbol_addr >> 2) & 0x3FFFFFF);
+        case RelocationType::ABS32:
+            return symbol_addr;
+    }
+    throw std::runtime_error("Unknown relocation type");
+}
+
+}
+
+BinaryOutput link(const std::vector<ObjectFile>& objects) {
+    BinaryOutput output;
+    std::vector<uint32_t> text_base;
+    std::vector<uint32_t> data_base;
+    for (const auto& object : objects) {
+        text_base.push_back(static_cast<uint32_t>(output.instructions.size()));
+        data_base.push_back(static_cast<uint32_t>(output.data.size()));
+        output.instructions.insert(output.instructions.end(), object.text.begin(), object.text.end());
+        output.data.insert(output.data.end(), object.data.begin(), object.data.end());
+    }
+
+    auto address_of = [&](const size_t idx, const ObjectSymbol& symbol) {
+        return (symbol.section == Section::DATA ? data_base[idx] : text_base[idx]) + symbol.value;
+    };
+
+    std::unordered_map<std::string, uint32_t> globals;
+    for (size_t idx = 0; idx < objects.size(); ++idx) {
+        for (const auto& symbol : objects[idx].symbols) {
+            if (symbol.binding != SymbolBinding::GLOBAL) continue;
+            if (!globals.try_emplace(symbol.name, address_of(idx, symbol)).second) {
+                throw std::runtime_error("Duplicate global symbol: " + symbol.name);
+            }
+        }
+    }
+
+    for (size_t idx = 0; idx < objects.size(); ++idx) {
+        const auto& object = objects[idx];
+        std::unordered_map<std::string, const ObjectSymbol*> symbols;
+        for (const auto& symbol : object.symbols) symbols[symbol.name] = &symbol;
+
+        for (const auto& relocation : object.relocations) {
+            const auto* symbol = symbols.at(relocation.symbol);
+            uint32_t symbol_addr;
+            if (symbol->binding == SymbolBinding::UNDEFINED) {
+                const auto it = globals.find(symbol->name);
+                if (it == globals.end()) throw std::runtime_error("Undefined symbol: " + symbol->name);
+                symbol_addr = it->second;
+            } else {
+                symbol_addr = address_of(idx, *symbol);
+            }
+
+            auto& buffer = relocation.section == Section::DATA ? output.data : output.instructions;
+            const auto place = (relocation.section == Section::DATA ? data_base[idx] : text_base[idx]) + relocation.offset;
+            utils::write_uint32(&buffer[place], patch(utils::read_uint32(&buffer[place]), relocation, symbol_addr, place));
+        }
+    }
+    return output;
+}
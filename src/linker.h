@@ -0,0 +1,14 @@
+#ifndef LINKER_H
+#define LINKER_H
+
+
+#include "object.h"
+
+#include <vector>
+
+
+// lays the objects' sections out one after the other in the given order, binds
+// every import to the one object exporting it and fills in the relocated fields
+BinaryOutput link(const std::vector<ObjectFile>& objects);
+
+#endif // LINKER_H
@@ -1,28 +1,255 @@
 #include "assembler.h"
+#include "hot_spots.h"
+#include "linker.h"
+#include "server.h"
+#include "output_pipeline.h"
+#include "watch.h"
 
 #include <iostream>
 #include <fstream>
+#include <optional>
 #include <string>
+#include <vector>
 
 
+namespace {
+
+int serve(const int argc, char* argv[]) {
+    std::string socket_path;
+    unsigned threads = 0;
+    auto stdio = false;
+
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--stdio") {
+            stdio = true;
+        } else if (arg == "--socket" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " serve (--stdio | --socket path) [--threads n]\n";
+            return 1;
+        }
+    }
+    if (stdio == !socket_path.empty()) {
+        std::cerr << "Usage: " << argv[0] << " serve (--stdio | --socket path) [--threads n]\n";
+        return 1;
+    }
+
+    try {
+        AssemblerServer server(threads);
+        if (stdio) {
+            server.serve_stdio();
+        } else {
+            server.serve_socket(socket_path);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Server error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int link_objects(const int argc, char* argv[]) {
+    if (argc < 7) {
+        std::cerr << "Usage: " << argv[0] << " link object.o... inst_template.vhd inst_mem.vhd"
+                     " data_template.vhd data_mem.vhd\n";
+        return 1;
+    }
+
+    try {
+        std::vector<ObjectFile> objects;
+        for (int i = 2; i < argc - 4; ++i) objects.push_back(read_object(argv[i]));
+
+        const auto [instructions, data] = link(objects);
+        OutputPipeline pipeline({argv[argc - 4], argv[argc - 3]}, {argv[argc - 2], argv[argc - 1]});
+        pipeline.encoded(Section::TEXT, instructions.data(), instructions.size());
+        pipeline.encoded(Section::DATA, data.data(), data.size());
+        pipeline.finish();
+
+        std::cout << "Link Successful\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Link error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int profile(const int argc, char* argv[]) {
+    std::vector<std::string> paths;
+    std::string source_path;
+    size_t top = 10;
+
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--source" && i + 1 < argc) {
+            source_path = argv[++i];
+        } else if (arg == "--top" && i + 1 < argc) {
+            top = std::stoul(argv[++i]);
+        } else if (!arg.starts_with("--")) {
+            paths.push_back(arg);
+        } else {
+            paths.clear();
+            break;
+        }
+    }
+    if (paths.size() != 2) {
+        std::cerr << "Usage: " << argv[0] << " profile program.map trace.txt [--source program.asm] [--top n]\n";
+        return 1;
+    }
+
+    try {
+        const auto map = load_source_map(paths[0]);
+        const auto counts = count_trace(paths[1], map.entries.size());
+
+        std::vector<std::string> source;
+        if (!source_path.empty()) {
+            std::ifstream in(source_path);
+            if (!in) throw std::runtime_error("Failed to open source file: " + source_path);
+            for (std::string line; std::getline(in, line);) {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                source.push_back(std::move(line));
+            }
+        }
+        print_hot_spots(std::cout, map, counts, top, source_path.empty() ? nullptr : &source);
+    } catch (const std::exception& e) {
+        std::cerr << "Profile error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 6) {
+    if (argc >= 2 && std::string(argv[1]) == "serve") {
+        return serve(argc, argv);
+    }
+    if (argc >= 2 && std::string(argv[1]) == "link") {
+        return link_objects(argc, argv);
+    }
+    if (argc >= 2 && std::string(argv[1]) == "profile") {
+        return profile(argc, argv);
+    }
+
+    AssemblerOptions options;
+    std::vector<std::string> paths;
+    auto watching = false;
+    auto object_only = false;
+    auto stats = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--watch") {
+            watching = true;
+        } else if (arg == "-c") {
+            object_only = true;
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--eliminate-dead") {
+            options.eliminate_dead_code = true;
+        } else if (arg == "--layout") {
+            options.optimize_layout = true;
+        } else if (arg == "--layout-profile") {
+            if (++i == argc) {
+                std::cerr << "Missing file name after " << arg << "\n";
+                return 1;
+            }
+            options.optimize_layout = true;
+            options.layout_profile_path = argv[i];
+        } else if (arg == "--map") {
+            if (++i == argc) {
+                std::cerr << "Missing file name after " << arg << "\n";
+                return 1;
+            }
+            options.source_map_path = argv[i];
+        } else if (arg == "--core") {
+            const std::string core = ++i < argc ? argv[i] : "";
+            if (core == "classic") {
+                options.core = TargetCore::CLASSIC;
+            } else if (core == "extended") {
+                options.core = TargetCore::EXTENDED;
+            } else {
+                std::cerr << "Expected 'classic' or 'extended' after --core\n";
+                return 1;
+            }
+        } else if (arg.starts_with("--")) {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (stats && watching) {
+        std::cerr << "--stats measures a single assembly and cannot be combined with --watch\n";
+        return 1;
+    }
+    // object files are relocated by the link step, so only final addresses are mapped
+    if (!options.source_map_path.empty() && (watching || object_only)) {
+        std::cerr << "--map needs a one-shot assembly to the memories, without --watch or -c\n";
+        return 1;
+    }
+    // opening the counters costs a syscall each, so only --stats pays for them
+    std::optional<PhaseProfiler> profiler;
+    if (stats) options.profiler = &profiler.emplace();
+
+    if (object_only && paths.size() == 2 && !watching) {
+        std::ifstream in(paths[0]);
+        if (!in) {
+            std::cerr << "Failed to open input file: " << paths[0] << "\n";
+            return 1;
+        }
+        const std::string input((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        options.diagnostics = &std::cout;
+        try {
+            Assembler(input, options).assemble_object(paths[1]);
+            if (profiler) profiler->print(std::cout);
+        } catch (const std::exception& e) {
+            std::cerr << "Assembly error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (paths.size() != 5 || object_only) {
         std::cerr << "Usage:\n"
                   << "  " << argv[0]
-                  << " path/to/input.asm"
+                  << " [options]"
+                     " path/to/input.asm"
                      " path/to/inst_template.vhd"
                      " path/to/inst_mem.vhd"
                      " path/to/data_template.vhd"
-                     " path/to/data_mem.vhd\n";
+                     " path/to/data_mem.vhd\n"
+                  << "  " << argv[0] << " [options] -c path/to/input.asm path/to/output.o\n"
+                  << "  " << argv[0] << " link a.o b.o... path/to/inst_template.vhd path/to/inst_mem.vhd"
+                     " path/to/data_template.vhd path/to/data_mem.vhd\n"
+                  << "  " << argv[0] << " serve (--stdio | --socket path) [--threads n]\n"
+                  << "  " << argv[0] << " profile program.map trace.txt [--source program.asm] [--top n]\n"
+                  << "Options:\n"
+                  << "  --core c           target core: classic (default) or extended (j, jal, bne, addi, slt, ...)\n"
+                  << "  --eliminate-dead   remove unreachable instructions and unreferenced .word data\n"
+                  << "  --layout           reorder blocks so likely branches fall through\n"
+                  << "  --layout-profile f same, weighting blocks by the execution counts in f\n"
+                  << "  --map f            write the source line and label of every instruction address to f\n"
+                  << "  --stats            print the time and hardware counters of each phase\n"
+                  << "  --watch            keep running and reassemble whenever the input changes\n";
         return 1;
     }
 
 
-    std::string input_file  = argv[1];
-    std::string inst_tmpl   = argv[2];
-    std::string inst_out    = argv[3];
-    std::string data_tmpl   = argv[4];
-    std::string data_out    = argv[5];
+    std::string input_file  = paths[0];
+    std::string inst_tmpl   = paths[1];
+    std::string inst_out    = paths[2];
+    std::string data_tmpl   = paths[3];
+    std::string data_out    = paths[4];
+
+    options.diagnostics = &std::cout;
+
+    if (watching) {
+        watch(input_file, inst_tmpl, inst_out, data_tmpl, data_out, options);
+    }
 
     std::ifstream in(input_file);
     if (!in) {
@@ -32,7 +259,7 @@ int main(int argc, char* argv[]) {
     std::string input((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
 
     try {
-        Assembler assembler(input);
+        Assembler assembler(input, options);
         assembler.assemble(
             inst_out,
             data_out,
@@ -41,6 +268,7 @@ int main(int argc, char* argv[]) {
         );
 
         std::cout << "Assembly Successful\n";
+        if (profiler) profiler->print(std::cout);
 
     } catch (const std::exception& e) {
         std::cerr << "Assembly error: " << e.what() << std::endl;
@@ -48,4 +276,4 @@ int main(int argc, char* argv[]) {
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,49 @@
+#include "mapped_file.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile(const std::string& path) {
+#ifndef _WIN32
+    const auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Failed to open binary file: " + path);
+
+    struct stat info{};
+    if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ == 0) {
+            ::close(fd);
+            return;
+        }
+        if (auto* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0); addr != MAP_FAILED) {
+            ::close(fd);
+            data_ = static_cast<const uint8_t*>(addr);
+            mapped_ = true;
+            return;
+        }
+    }
+    ::close(fd);
+#endif
+
+    // no mapping: pipes, special files, other platforms
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Failed to open binary file: " + path);
+    buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (mapped_) ::munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+}
@@ -0,0 +1,216 @@
+#include "object.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+
+
+namespace {
+
+constexpr char MAGIC[4] = {'M', 'O', 'B', 'J'};
+constexpr uint16_t VERSION = 1;
+
+void put_u8(std::string& out, const uint8_t value) {
+    out += static_cast<char>(value);
+}
+
+void put_u16(std::string& out, const uint16_t value) {
+    out += static_cast<char>(value >> 8);
+    out += static_cast<char>(value);
+}
+
+void put_u32(std::string& out, const uint32_t value) {
+    put_u16(out, static_cast<uint16_t>(value >> 16));
+    put_u16(out, static_cast<uint16_t>(value));
+}
+
+// bounds-checked cursor over the file contents
+class ObjectReader {
+public:
+    ObjectReader(const std::string& bytes, const std::string& path) : bytes_(bytes), path_(path) {}
+
+    uint8_t u8() {
+        need(1);
+        return static_cast<uint8_t>(bytes_[pos_++]);
+    }
+
+    uint16_t u16() {
+        const auto high = u8();
+        return static_cast<uint16_t>((high << 8) | u8());
+    }
+
+    uint32_t u32() {
+        const auto high = u16();
+        return (static_cast<uint32_t>(high) << 16) | u16();
+    }
+
+    std::vector<uint8_t> bytes(const size_t size) {
+        need(size);
+        std::vector<uint8_t> out(bytes_.begin() + static_cast<long>(pos_), bytes_.begin() + static_cast<long>(pos_ + size));
+        pos_ += size;
+        return out;
+    }
+
+    [[noreturn]] void fail() const {
+        throw std::runtime_error("Malformed object file: " + path_);
+    }
+
+private:
+    void need(const size_t size) const {
+        if (size > bytes_.size() - pos_) fail();
+    }
+
+    const std::string& bytes_;
+    const std::string& path_;
+    size_t pos_ = 0;
+};
+
+}
+
+ObjectFile make_object(const AST& ast, const SymbolTable& sym_table, BinaryOutput output,
+                       std::vector<Relocation> relocations) {
+    ObjectFile object;
+    object.text = std::move(output.instructions);
+    object.data = std::move(output.data);
+
+    std::unordered_map<std::string, size_t> indices;
+    auto add_symbol = [&](const std::string& name, const bool exported) {
+        const auto [it, inserted] = indices.try_emplace(name, object.symbols.size());
+        if (!inserted) {
+            if (exported && object.symbols[it->second].binding == SymbolBinding::LOCAL) {
+                object.symbols[it->second].binding = SymbolBinding::GLOBAL;
+            }
+            return;
+        }
+        if (const auto addr = sym_table.get(name)) {
+            object.symbols.push_back({name, exported ? SymbolBinding::GLOBAL : SymbolBinding::LOCAL,
+                                      *sym_table.section(name), *addr});
+        } else {
+            object.symbols.push_back({name, SymbolBinding::UNDEFINED, Section::NONE, 0});
+        }
+    };
+
+    for (const auto& node : ast.nodes) {
+        const auto* dir = dynamic_cast<const DirectiveNode*>(node.get());
+        if (!dir || dir->name != "globl") continue;
+        for (const auto& name : dir->values) add_symbol(name, true);
+    }
+    for (const auto& relocation : relocations) add_symbol(relocation.symbol, false);
+
+    object.relocations = std::move(relocations);
+    return object;
+}
+
+void write_object(const std::string& path, const ObjectFile& object) {
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> name_offsets;
+    std::unordered_map<std::string, uint32_t> symbol_indices;
+    for (uint32_t idx = 0; idx < object.symbols.size(); ++idx) {
+        const auto& name = object.symbols[idx].name;
+        name_offsets[name] = static_cast<uint32_t>(strings.size());
+        symbol_indices[name] = idx;
+        strings += name;
+        strings += '\0';
+    }
+
+    std::string out;
+    out.reserve(32 + object.text.size() + object.data.size() + 12 * object.symbols.size() +
+                12 * object.relocations.size() + strings.size());
+    out.append(MAGIC, sizeof(MAGIC));
+    put_u16(out, VERSION);
+    put_u16(out, 0);
+    put_u32(out, static_cast<uint32_t>(object.text.size()));
+    put_u32(out, static_cast<uint32_t>(object.data.size()));
+    put_u32(out, static_cast<uint32_t>(object.symbols.size()));
+    put_u32(out, static_cast<uint32_t>(object.relocations.size()));
+    put_u32(out, static_cast<uint32_t>(strings.size()));
+    out.append(object.text.begin(), object.text.end());
+    out.append(object.data.begin(), object.data.end());
+
+    for (const auto& symbol : object.symbols) {
+        put_u32(out, name_offsets[symbol.name]);
+        put_u8(out, static_cast<uint8_t>(symbol.binding));
+        put_u8(out, static_cast<uint8_t>(symbol.section));
+        put_u16(out, 0);
+        put_u32(out, symbol.value);
+    }
+    for (const auto& relocation : object.relocations) {
+        put_u8(out, static_cast<uint8_t>(relocation.section));
+        put_u8(out, static_cast<uint8_t>(relocation.type));
+        put_u16(out, 0);
+        put_u32(out, relocation.offset);
+        put_u32(out, symbol_indices.at(relocation.symbol));
+    }
+    out += strings;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) throw std::runtime_error("Failed to write to file: " + path);
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+}
+
+ObjectFile read_object(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("Failed to open object file: " + path);
+    const std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    ObjectReader in(bytes, path);
+    for (const auto c : MAGIC) {
+        if (in.u8() != static_cast<uint8_t>(c)) throw std::runtime_error("Not an object file: " + path);
+    }
+    if (in.u16() != VERSION) throw std::runtime_error("Unsupported object file version: " + path);
+    in.u16();
+
+    const auto text_size = in.u32();
+    const auto data_size = in.u32();
+    const auto symbol_count = in.u32();
+    const auto relocation_count = in.u32();
+    const auto strings_size = in.u32();
+    if (text_size % 4 != 0 || data_size % 4 != 0) in.fail();
+
+    ObjectFile object;
+    object.text = in.bytes(text_size);
+    object.data = in.bytes(data_size);
+
+    std::vector<uint32_t> name_offsets;
+    for (uint32_t idx = 0; idx < symbol_count; ++idx) {
+        ObjectSymbol symbol;
+        name_offsets.push_back(in.u32());
+        symbol.binding = static_cast<SymbolBinding>(in.u8());
+        symbol.section = static_cast<Section>(in.u8());
+        in.u16();
+        symbol.value = in.u32();
+        if (symbol.binding > SymbolBinding::UNDEFINED || symbol.section > Section::NONE) in.fail();
+        object.symbols.push_back(symbol);
+    }
+
+    std::vector<uint32_t> symbol_indices;
+    for (uint32_t idx = 0; idx < relocation_count; ++idx) {
+        Relocation relocation;
+        relocation.section = static_cast<Section>(in.u8());
+        relocation.type = static_cast<RelocationType>(in.u8());
+        in.u16();
+        relocation.offset = in.u32();
+        symbol_indices.push_back(in.u32());
+
+        const auto size = relocation.section == Section::TEXT ? text_size : data_size;
+        if (relocation.section > Section::DATA || relocation.type > RelocationType::ABS32 ||
+            relocation.offset % 4 != 0 || relocation.offset >= size || symbol_indices.back() >= symbol_count) {
+            in.fail();
+        }
+        object.relocations.push_back(relocation);
+    }
+
+    const auto strings = in.bytes(strings_size);
+    for (uint32_t idx = 0; idx < symbol_count; ++idx) {
+        const auto offset = name_offsets[idx];
+        size_t end = offset;
+        while (end < strings.size() && strings[end] != 0) ++end;
+        if (end >= strings.size()) in.fail();
+        object.symbols[idx].name.assign(strings.begin() + offset, strings.begin() + static_cast<long>(end));
+    }
+    for (uint32_t idx = 0; idx < relocation_count; ++idx) {
+        object.relocations[idx].symbol = object.symbols[symbol_indices[idx]].name;
+    }
+    return object;
+}
@@ -0,0 +1,46 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+
+#include "code_gen.h"
+
+#include <string>
+#include <vector>
+
+
+enum class SymbolBinding : uint8_t {
+    LOCAL,     // only named by this object's relocations
+    GLOBAL,    // exported with .globl
+    UNDEFINED  // imported, defined by another object
+};
+
+struct ObjectSymbol {
+    std::string name;
+    SymbolBinding binding;
+    Section section; // NONE when undefined
+    uint32_t value;  // offset inside the section
+};
+
+// one separately assembled source: section bytes with every symbol address the
+// linker may move left zero, plus what is needed to fill those fields in
+struct ObjectFile {
+    std::vector<uint8_t> text;
+    std::vector<uint8_t> data;
+    std::vector<ObjectSymbol> symbols;
+    std::vector<Relocation> relocations;
+};
+
+ObjectFile make_object(const AST& ast, const SymbolTable& sym_table, BinaryOutput output,
+                       std::vector<Relocation> relocations);
+
+// big-endian throughout:
+//   "MOBJ", u16 version, u16 reserved
+//   u32 text size, data size, symbol count, relocation count, string table size
+//   text bytes, data bytes
+//   symbols:     u32 name offset, u8 binding, u8 section, u16 reserved, u32 value
+//   relocations: u8 section, u8 type, u16 reserved, u32 offset, u32 symbol index
+//   string table of NUL-terminated names
+void write_object(const std::string& path, const ObjectFile& object);
+ObjectFile read_object(const std::string& path);
+
+#endif // OBJECT_H
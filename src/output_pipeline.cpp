@@ -0,0 +1,192 @@
+#include "output_pipeline.h"
+#include "bounded_queue.h"
+#include "utils.h"
+
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+
+namespace {
+
+// chunks waiting between two stages of one memory
+constexpr size_t QUEUE_DEPTH = 4;
+
+}
+
+struct OutputPipeline::Memory {
+    explicit Memory(MemoryOutput output) : output(std::move(output)) {
+        // a device such as /dev/stdout cannot be replaced, so it is written in place
+        std::error_code ec;
+        const auto status = std::filesystem::status(this->output.output_path, ec);
+        in_place = std::filesystem::exists(status) && !std::filesystem::is_regular_file(status);
+        path = in_place ? this->output.output_path : this->output.output_path + ".part";
+
+        formatter = std::thread([this] { format(); });
+        writer = std::thread([this] { write(); });
+    }
+
+    ~Memory() {
+        stop();
+        join();
+    }
+
+    Memory(const Memory&) = delete;
+    Memory& operator=(const Memory&) = delete;
+
+    // template lines around the words, one text chunk per byte chunk
+    void format() {
+        try {
+            const auto tmpl = utils::load_template(output.template_path, std::string(subs_token));
+            std::string head;
+            utils::append_lines(head, tmpl, 0, tmpl.marker);
+            if (!text.push(std::move(head))) return;
+
+            size_t index = 0;
+            while (auto chunk = bytes.pop()) {
+                std::string lines;
+                lines.reserve(chunk->size() / 4 * 48);
+                utils::append_words(lines, chunk->data(), chunk->size(), index);
+                index += chunk->size() / 4;
+                if (!text.push(std::move(lines))) return;
+            }
+
+            std::string tail;
+            utils::append_trailer(tail, tmpl);
+            text.push(std::move(tail));
+            text.close();
+        } catch (...) {
+            format_error = std::current_exception();
+            stop();
+        }
+    }
+
+    void write() {
+        try {
+            std::ofstream out(path, std::ios::trunc);
+            if (!out) throw std::runtime_error("Failed to write to file: " + output.output_path);
+            while (const auto lines = text.pop()) {
+                out.write(lines->data(), static_cast<std::streamsize>(lines->size()));
+            }
+            out.flush();
+            if (!out) throw std::runtime_error("Failed to write to file: " + output.output_path);
+        } catch (...) {
+            write_error = std::current_exception();
+            stop();
+        }
+    }
+
+    void stop() {
+        bytes.abort();
+        text.abort();
+    }
+
+    void join() {
+        if (formatter.joinable()) formatter.join();
+        if (writer.joinable()) writer.join();
+    }
+
+    void discard() const {
+        if (in_place) return;
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+
+    std::string backup_path() const { return output.output_path + ".old"; }
+
+    // puts the previous output back and drops the new one
+    void restore() {
+        std::error_code ec;
+        if (backed_up) {
+            std::filesystem::rename(backup_path(), output.output_path, ec);
+        } else if (installed) {
+            std::filesystem::remove(output.output_path, ec);
+        }
+        backed_up = installed = false;
+        discard();
+    }
+
+    MemoryOutput output;
+    std::string path; // what the writer writes to
+    bool in_place = false;
+    bool backed_up = false; // the previous output was moved to backup_path()
+    bool installed = false; // path was moved to the output
+    BoundedQueue<std::vector<uint8_t>> bytes{QUEUE_DEPTH};
+    BoundedQueue<std::string> text{QUEUE_DEPTH};
+    std::exception_ptr format_error;
+    std::exception_ptr write_error;
+    std::thread formatter;
+    std::thread writer;
+};
+
+OutputPipeline::OutputPipeline(MemoryOutput instructions, MemoryOutput data)
+    : instructions_(std::make_unique<Memory>(std::move(instructions))),
+      data_(std::make_unique<Memory>(std::move(data))) {}
+
+OutputPipeline::~OutputPipeline() {
+    if (instructions_->formatter.joinable()) abort();
+}
+
+void OutputPipeline::encoded(const Section section, const uint8_t* bytes, const size_t size) {
+    auto& memory = section == Section::DATA ? *data_ : *instructions_;
+    // a stage that failed already dropped the chunk; finish() reports why
+    memory.bytes.push(std::vector<uint8_t>(bytes, bytes + size));
+}
+
+void OutputPipeline::finish() {
+    instructions_->bytes.close();
+    data_->bytes.close();
+    instructions_->join();
+    data_->join();
+
+    for (const auto* memory : {instructions_.get(), data_.get()}) {
+        for (const auto& error : {memory->format_error, memory->write_error}) {
+            if (!error) continue;
+            instructions_->discard();
+            data_->discard();
+            std::rethrow_exception(error);
+        }
+    }
+
+    // the old files are moved aside first, so either both new ones are in place or both old ones are back
+    const auto roll_back = [this] {
+        for (auto* memory : {instructions_.get(), data_.get()}) memory->restore();
+    };
+    for (auto* memory : {instructions_.get(), data_.get()}) {
+        if (memory->in_place) continue;
+        std::error_code ec;
+        if (std::filesystem::exists(memory->output.output_path, ec)) {
+            std::filesystem::rename(memory->output.output_path, memory->backup_path(), ec);
+            if (ec) {
+                roll_back();
+                throw std::runtime_error("Failed to write to file: " + memory->output.output_path);
+            }
+            memory->backed_up = true;
+        }
+    }
+    for (auto* memory : {instructions_.get(), data_.get()}) {
+        if (memory->in_place) continue;
+        std::error_code ec;
+        std::filesystem::rename(memory->path, memory->output.output_path, ec);
+        if (ec) {
+            roll_back();
+            throw std::runtime_error("Failed to write to file: " + memory->output.output_path);
+        }
+        memory->installed = true;
+    }
+    for (const auto* memory : {instructions_.get(), data_.get()}) {
+        if (!memory->backed_up) continue;
+        std::error_code ec;
+        std::filesystem::remove(memory->backup_path(), ec);
+    }
+}
+
+void OutputPipeline::abort() {
+    for (auto* memory : {instructions_.get(), data_.get()}) {
+        memory->stop();
+        memory->join();
+        memory->discard();
+    }
+}
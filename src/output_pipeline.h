@@ -0,0 +1,47 @@
+#ifndef OUTPUT_PIPELINE_H
+#define OUTPUT_PIPELINE_H
+
+
+#include "code_gen.h"
+
+#include <memory>
+#include <string>
+
+
+// where one memory image goes
+struct MemoryOutput {
+    std::string template_path;
+    std::string output_path;
+};
+
+// renders and writes the instruction and data memories while pass2 is still
+// encoding them: per memory, a formatter thread turns byte chunks into template
+// lines and a writer thread appends those to the file, with bounded queues in
+// between. The files are written aside and only replace the old ones once both
+// are complete; the old ones are moved out of the way first and put back if
+// either rename fails, so a failed assembly leaves them untouched.
+class OutputPipeline final : public EncodeListener {
+public:
+    OutputPipeline(MemoryOutput instructions, MemoryOutput data);
+    // aborts unless finish() ran
+    ~OutputPipeline() override;
+
+    OutputPipeline(const OutputPipeline&) = delete;
+    OutputPipeline& operator=(const OutputPipeline&) = delete;
+
+    void encoded(Section section, const uint8_t* bytes, size_t size) override;
+
+    // every byte was handed over: waits for both files and moves them into place,
+    // rethrowing the error of a failed stage
+    void finish();
+    // stops every stage and discards what was written so far
+    void abort();
+
+private:
+    struct Memory;
+
+    std::unique_ptr<Memory> instructions_;
+    std::unique_ptr<Memory> data_;
+};
+
+#endif // OUTPUT_PIPELINE_H
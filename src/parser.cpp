@@ -5,15 +5,21 @@
 #include <algorithm>
 
 
-Parser::Parser(Lexer& lexer)
-    : lexer_(lexer), current_token_{}, next_token_{} {
-    current_token_ = lexer_.next_token();
-    next_token_ = lexer_.next_token();
+Parser::Parser(TokenSource& tokens)
+    : tokens_(tokens), current_token_{}, next_token_{} {
+    current_token_ = tokens_.next_token();
+    next_token_ = tokens_.next_token();
 }
 
 void Parser::advance() {
+    previous_line_ = current_token_.line;
     current_token_ = next_token_;
-    next_token_ = lexer_.next_token();
+    next_token_ = tokens_.next_token();
+}
+
+void Parser::skip_illegal() {
+    // the whole run at once, so a line of garbage costs one pass and no exceptions per token
+    while (current_token_.type == TokenType::ILLEGAL) advance();
 }
 
 void Parser::expect_token(TokenType expected, const std::string& error_msg) const {
@@ -38,7 +44,7 @@ std::string Parser::expect_register(const std::string& error_msg) {
     
     if (!is_valid_register(reg)) {
         std::ostringstream oss;
-        oss << "Invalid register name: " << reg << ". Valid registers: t0-t7, s0-s7, a0-a7, r0-r7";
+        oss << "Invalid register name: " << reg << ". Valid registers: t0-t7, s0-s7, a0-a7, r0-r7, v<n>";
         throw std::runtime_error(oss.str());
     }
     
@@ -68,13 +74,17 @@ bool Parser::is_itype_instruction(const std::string& mnemonic) const {
     return ITYPE_INSTRUCTIONS.contains(mnemonic);
 }
 
+bool Parser::is_jtype_instruction(const std::string& mnemonic) const {
+    return JTYPE_INSTRUCTIONS.contains(mnemonic);
+}
+
 bool Parser::is_valid_register(const std::string& reg) {
     // $ prefix for registers is removed
     auto reg_name = reg;
     if (!reg_name.empty() && reg_name[0] == '$') {
         reg_name = reg_name.substr(1);
     }
-    return REGISTERS.contains(reg_name);
+    return REGISTERS.contains(reg_name) || is_virtual_register(reg_name);
 }
 
 std::unique_ptr<RTypeInst> Parser::parse_rtype() {
@@ -118,30 +128,56 @@ std::unique_ptr<ITypeInst> Parser::parse_itype() {
     inst->mnemonic = current_token_.literal;
     advance();
     
-    if (inst->mnemonic == "beq") {
-        // beq rs, rt, label
-        inst->rs = expect_register("Expected first register for beq");
+    if (inst->mnemonic == "beq" || inst->mnemonic == "bne") {
+        // beq/bne rs, rt, label
+        inst->rs = expect_register("Expected first register for " + inst->mnemonic);
         expect_token(TokenType::COMMA, "Expected comma after first register");
         advance();
-        inst->rt = expect_register("Expected second register for beq");
+        inst->rt = expect_register("Expected second register for " + inst->mnemonic);
         expect_token(TokenType::COMMA, "Expected comma after second register");
         advance();
         // label reference
-        expect_token(TokenType::IDENT, "Expected label name for beq");
-        inst->imm_or_label = current_token_.literal;
-        inst->is_label_ref = true;
+        expect_token(TokenType::IDENT, "Expected label name for " + inst->mnemonic);
+        inst->set_label(current_token_);
+        advance();
+    } else if (inst->mnemonic == "addi" || inst->mnemonic == "slti" ||
+               inst->mnemonic == "andi" || inst->mnemonic == "ori") {
+        // addi/slti/andi/ori rt, rs, imm - the immediate may be a label address
+        inst->rt = expect_register("Expected target register for " + inst->mnemonic);
+        expect_token(TokenType::COMMA, "Expected comma after target register");
         advance();
+        inst->rs = expect_register("Expected source register for " + inst->mnemonic);
+        expect_token(TokenType::COMMA, "Expected comma after source register");
+        advance();
+        if (current_token_.type == TokenType::IDENT) {
+            inst->set_label(current_token_);
+            advance();
+        } else {
+            inst->imm_or_label = expect_number_or_label("Expected immediate value or label at line " +
+                                                        std::to_string(current_token_.line));
+        }
     } else if (inst->mnemonic == "lw" || inst->mnemonic == "sw") {
-        // lw/sw rt, imm(rs) - lw/sw rt, label - lw/sw rt, label(rs)
+        // lw/sw rt, imm(rs) - lw/sw rt, label - lw/sw rt, label(rs) - lw rt, =constant
         inst->rt = expect_register("Expected target register for lw/sw");
         expect_token(TokenType::COMMA, "Expected comma after target register");
         advance();
         
-        // label or immediate value
-        if (current_token_.type == TokenType::IDENT) {
-            // label
-            inst->imm_or_label = current_token_.literal;
+        // literal pool constant, label or immediate value
+        if (current_token_.type == TokenType::EQUALS) {
+            if (inst->mnemonic != "lw") {
+                throw std::runtime_error("Literal operand is only allowed for lw at line " + std::to_string(current_token_.line));
+            }
+            advance();
+            if (current_token_.type != TokenType::NUMBER && current_token_.type != TokenType::IDENT) {
+                expect_token(TokenType::NUMBER, "Expected constant or label after '='");
+            }
+            inst->imm_or_label = "=" + current_token_.literal;
             inst->is_label_ref = true;
+            inst->is_literal = true;
+            advance();
+        } else if (current_token_.type == TokenType::IDENT) {
+            // label
+            inst->set_label(current_token_);
             advance();
             
             if (current_token_.type == TokenType::LPAREN) {
@@ -169,6 +205,24 @@ std::unique_ptr<ITypeInst> Parser::parse_itype() {
     return inst;
 }
 
+std::unique_ptr<JTypeInst> Parser::parse_jtype() {
+    auto inst = std::make_unique<JTypeInst>();
+
+    // mnemonic
+    expect_token(TokenType::INST, "Expected instruction mnemonic");
+    inst->mnemonic = current_token_.literal;
+    advance();
+
+    // j/jal label - j/jal address
+    if (current_token_.type != TokenType::NUMBER && current_token_.type != TokenType::IDENT) {
+        throw std::runtime_error("Expected jump target at line " + std::to_string(current_token_.line));
+    }
+    inst->set_target(current_token_);
+    advance();
+
+    return inst;
+}
+
 std::unique_ptr<DirectiveNode> Parser::parse_directive() {
     auto dir = std::make_unique<DirectiveNode>();
     
@@ -177,21 +231,53 @@ std::unique_ptr<DirectiveNode> Parser::parse_directive() {
     
     // directive name
     expect_token(TokenType::IDENT, "Expected directive name after '.'");
-    dir->name = current_token_.literal;
+    dir->name = current_token_.literal == "global" ? "globl" : current_token_.literal;
     advance();
     
     if (current_token_.type == TokenType::COLON) {
         advance();
     }
     
-    // .word values if applicable
-    if (dir->name == "word") {
+    if (dir->name == "space") {
+        // .space bytes, rounded up to whole words
+        expect_token(TokenType::NUMBER, "Expected byte count after .space");
+        long long bytes;
+        try {
+            bytes = std::stoll(current_token_.literal, nullptr, 0);
+        } catch (...) {
+            throw std::runtime_error("Invalid .space size at line " + std::to_string(current_token_.line));
+        }
+        if (bytes < 0 || bytes > 0x7FFFFFFC) {
+            throw std::runtime_error("Invalid .space size at line " + std::to_string(current_token_.line));
+        }
+        dir->size = static_cast<uint32_t>((bytes + 3) & ~3LL);
+        advance();
+    } else if (dir->name == "incbin") {
+        // .incbin "file" - .incbin "file", le
+        expect_token(TokenType::STRING, "Expected quoted file name after .incbin");
+        dir->values.push_back(current_token_.literal);
+        advance();
+        if (current_token_.type == TokenType::COMMA) {
+            advance();
+            if (current_token_.type != TokenType::IDENT ||
+                (current_token_.literal != "le" && current_token_.literal != "be")) {
+                throw std::runtime_error("Expected 'le' or 'be' after .incbin file name at line " +
+                                         std::to_string(current_token_.line));
+            }
+            dir->byteswap = current_token_.literal == "le";
+            advance();
+        }
+    }
+
+    // .word values or .globl names if applicable
+    if (dir->name == "word" || dir->name == "globl") {
         // parse a comma-separated list of numbers or identifiers
         bool expect_value = true;
         while (true) {
             if (expect_value) {
-                if (current_token_.type == TokenType::NUMBER || current_token_.type == TokenType::IDENT) {
-                    dir->values.push_back(current_token_.literal);
+                if ((current_token_.type == TokenType::NUMBER && dir->name == "word") ||
+                    current_token_.type == TokenType::IDENT) {
+                    dir->add_value(current_token_);
                     advance();
                     expect_value = false;
                 } else {
@@ -216,7 +302,7 @@ std::unique_ptr<LabelNode> Parser::parse_label() {
     auto label = std::make_unique<LabelNode>();
     
     expect_token(TokenType::IDENT, "Expected label name");
-    label->name = current_token_.literal;
+    label->set_name(current_token_);
     advance();
     
     expect_token(TokenType::COLON, "Expected ':' after label name");
@@ -234,7 +320,7 @@ std::unique_ptr<Node> Parser::parse_statement() {
     // ident
     if (current_token_.type == TokenType::IDENT && next_token_.type == TokenType::COLON) {
         auto label = std::make_unique<LabelNode>();
-        label->name = current_token_.literal;
+        label->set_name(current_token_);
         advance(); advance();
         return label;
     }
@@ -246,6 +332,8 @@ std::unique_ptr<Node> Parser::parse_statement() {
             return parse_rtype();
         } else if (is_itype_instruction(mnemonic)) {
             return parse_itype();
+        } else if (is_jtype_instruction(mnemonic)) {
+            return parse_jtype();
         } else {
             throw std::runtime_error("Unknown instruction: " + mnemonic);
         }
@@ -253,10 +341,17 @@ std::unique_ptr<Node> Parser::parse_statement() {
     
     // Skip illegal
     if (current_token_.type == TokenType::ILLEGAL) {
-        advance();
+        skip_illegal();
         return nullptr;
     }
     
+    // the classic core's lexer leaves the extended mnemonics as identifiers
+    if (current_token_.type == TokenType::IDENT && EXTENDED_INSTRUCTIONS.contains(current_token_.literal)) {
+        throw std::runtime_error("Instruction '" + current_token_.literal + "' at line " +
+                                 std::to_string(current_token_.line) +
+                                 " is not supported by the classic core (use --core extended)");
+    }
+
     std::ostringstream oss;
     oss << "Unexpected token in statement. Type: " << static_cast<int>(current_token_.type)
         << ", literal: '" << current_token_.literal << "', line: " << current_token_.line;
@@ -265,17 +360,21 @@ std::unique_ptr<Node> Parser::parse_statement() {
 
 AST Parser::parse() {
     AST ast;
+    ast.symbols = tokens_.symbols();
     
     while (current_token_.type != TokenType::EoF) {
         try {
+            const auto line = current_token_.line;
             auto node = parse_statement();
             if (node) {
+                node->line = line;
+                node->end_line = previous_line_;
                 ast.nodes.push_back(std::move(node));
             }
         } catch (const std::exception& e) {
             // try to recover from errors
             if (current_token_.type == TokenType::ILLEGAL) {
-                advance();
+                skip_illegal();
                 continue;
             }
             throw;
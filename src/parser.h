@@ -4,6 +4,7 @@
 
 #include "lexer.h"
 #include "common.h"
+#include "mapped_file.h"
 
 #include <memory>
 #include <vector>
@@ -23,31 +24,91 @@ struct ITypeInst : Node {
     std::string rt;         // Target/operand 1
     std::string rs;         // Base/operand 2 (optional for lw/sw if no (rs))
     std::string imm_or_label; // Immediate or label
+    uint32_t symbol = NO_SYMBOL; // interned imm_or_label when it names a label; what lookups use
     bool is_label_ref = false;
+    bool is_literal = false;  // lw rt, =value: imm_or_label names the literal pool entry
     
     ITypeInst() { type = NodeType::INSTRUCTION; }
+
+    // the operand becomes a label reference; name and ID always change together
+    void set_label(const Token& label) {
+        imm_or_label = label.literal;
+        symbol = label.symbol;
+        is_label_ref = true;
+    }
+    void set_label(std::string label, SymbolInterner& symbols) {
+        imm_or_label = std::move(label);
+        symbol = symbols.intern(imm_or_label);
+        is_label_ref = true;
+    }
+};
+
+struct JTypeInst : Node {
+    std::string mnemonic;
+    std::string target;     // label or absolute byte address
+    uint32_t symbol = NO_SYMBOL; // interned target when it names a label; what lookups use
+    bool is_label_ref = false;
+
+    JTypeInst() { type = NodeType::INSTRUCTION; }
+
+    // a label or an address, as the token says
+    void set_target(const Token& token) {
+        target = token.literal;
+        symbol = token.symbol;
+        is_label_ref = token.type == TokenType::IDENT;
+    }
 };
 
 struct DirectiveNode : Node {
     std::string name;
-    std::vector<std::string> values;  // for .word
+    std::vector<std::string> values;  // for .word, the names of .globl and the path of .incbin
+    std::vector<uint32_t> symbols;    // interned .word values, NO_SYMBOL for numbers; may be left empty
+    uint32_t size = 0;                // bytes of .space, and of .incbin once pass1 mapped the file
+    bool byteswap = false;            // .incbin "file", le: the file holds little-endian words
+    std::shared_ptr<const MappedFile> contents; // of .incbin, mapped by pass1
     
     DirectiveNode() { type = NodeType::DIRECTIVE; }
+
+    [[nodiscard]] uint32_t symbol(const size_t i) const { return i < symbols.size() ? symbols[i] : NO_SYMBOL; }
+    // keeps values and symbols in step
+    void add_value(const Token& token) {
+        values.push_back(token.literal);
+        symbols.push_back(token.symbol);
+    }
+
+    // bytes the directive takes in the data section
+    [[nodiscard]] uint32_t data_size() const {
+        if (name == "word") return 4 * static_cast<uint32_t>(values.size());
+        if (name == "space" || name == "incbin") return size;
+        return 0;
+    }
 };
 
 struct LabelNode : Node {
     std::string name;
+    uint32_t symbol = NO_SYMBOL; // interned name; what the symbol table is keyed by
     
     LabelNode() { type = NodeType::LABEL; }
+
+    void set_name(const Token& token) {
+        name = token.literal;
+        symbol = token.symbol;
+    }
+    void set_name(std::string label, SymbolInterner& symbols) {
+        name = std::move(label);
+        symbol = symbols.intern(name);
+    }
 };
 
 struct AST {
     std::vector<std::unique_ptr<Node>> nodes;
+    // the IDs stored in the nodes; passes that add label references intern them here
+    std::shared_ptr<SymbolInterner> symbols = std::make_shared<SymbolInterner>();
 };
 
 class Parser {
 public:
-    explicit Parser(Lexer& lexer);
+    explicit Parser(TokenSource& tokens);
 
     AST parse();
 
@@ -55,6 +116,8 @@ public:
 
 private:
     void advance();
+    // past a run of ILLEGAL tokens
+    void skip_illegal();
     void expect_token(TokenType expected, const std::string& error_msg) const;
     std::string expect_register(const std::string& error_msg);
     std::string expect_number_or_label(const std::string& error_msg);
@@ -62,15 +125,18 @@ private:
     std::unique_ptr<Node> parse_statement();
     std::unique_ptr<RTypeInst> parse_rtype();
     std::unique_ptr<ITypeInst> parse_itype();
+    std::unique_ptr<JTypeInst> parse_jtype();
     std::unique_ptr<DirectiveNode> parse_directive();
     std::unique_ptr<LabelNode> parse_label();
 
     [[nodiscard]] bool is_rtype_instruction(const std::string& mnemonic) const;
     [[nodiscard]] bool is_itype_instruction(const std::string& mnemonic) const;
+    [[nodiscard]] bool is_jtype_instruction(const std::string& mnemonic) const;
 
-    Lexer& lexer_;
+    TokenSource& tokens_;
     Token current_token_;
     Token next_token_;
+    int previous_line_ = 0; // line of the last consumed token
 };
 
 #endif // PARSER_H
\ No newline at end of file
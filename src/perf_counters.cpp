@@ -0,0 +1,198 @@
+#include "perf_counters.h"
+#include "utils.h"
+
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+
+constexpr std::array<const char*, COUNTER_COUNT> COUNTER_NAMES = {
+    "cycles", "instructions", "branch-miss", "L1d-miss", "LLC-miss", "page-faults"
+};
+
+#ifdef __linux__
+
+perf_event_attr attributes(const Counter counter) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    switch (counter) {
+        case Counter::CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case Counter::INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case Counter::BRANCH_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case Counter::L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case Counter::LLC_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case Counter::PAGE_FAULTS:
+            attr.type = PERF_TYPE_SOFTWARE;
+            attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+            break;
+    }
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1; // the output pipeline's threads
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return attr;
+}
+
+#endif
+
+std::string format_count(const std::optional<uint64_t>& value) {
+    return value ? std::to_string(*value) : "-";
+}
+
+std::optional<uint64_t> total(const std::vector<PhaseStats>& phases, const size_t counter) {
+    uint64_t sum = 0;
+    for (const auto& phase : phases) {
+        if (!phase.counters[counter]) return std::nullopt;
+        sum += *phase.counters[counter];
+    }
+    return sum;
+}
+
+void print_row(std::ostream& out, const std::string& name, const double milliseconds, const CounterSample& counters) {
+    out << std::left << std::setw(16) << name << std::right << std::setw(10) << std::fixed << std::setprecision(2)
+        << milliseconds;
+    for (size_t c = 0; c < COUNTER_COUNT; ++c) {
+        out << std::setw(14) << format_count(counters[c]);
+        if (c == static_cast<size_t>(Counter::INSTRUCTIONS)) {
+            const auto& cycles = counters[static_cast<size_t>(Counter::CYCLES)];
+            const auto& instructions = counters[c];
+            std::ostringstream ipc;
+            if (cycles && instructions && *cycles > 0) {
+                ipc << std::fixed << std::setprecision(2) << static_cast<double>(*instructions) / *cycles;
+            } else {
+                ipc << "-";
+            }
+            out << std::setw(7) << ipc.str();
+        }
+    }
+    out << "\n";
+}
+
+}
+
+PerfCounters::PerfCounters() {
+    fds_.fill(-1);
+#ifdef __linux__
+    for (size_t c = 0; c < COUNTER_COUNT; ++c) {
+        auto attr = attributes(static_cast<Counter>(c));
+        const auto fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        if (fd >= 0) {
+            fds_[c] = static_cast<int>(fd);
+        } else if (error_.empty()) {
+            error_ = std::string(COUNTER_NAMES[c]) + ": " + std::strerror(errno);
+        }
+    }
+#else
+    error_ = "perf_event_open needs Linux";
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (const auto fd : fds_) {
+        if (fd >= 0) close(fd);
+    }
+#endif
+}
+
+CounterSample PerfCounters::read() const {
+    CounterSample sample;
+#ifdef __linux__
+    for (size_t c = 0; c < COUNTER_COUNT; ++c) {
+        if (fds_[c] < 0) continue;
+        uint64_t values[3]; // value, time enabled, time running
+        if (::read(fds_[c], values, sizeof(values)) != sizeof(values) || values[2] == 0) continue;
+        sample[c] = values[2] < values[1]
+                        ? static_cast<uint64_t>(static_cast<double>(values[0]) * values[1] / values[2])
+                        : values[0];
+    }
+#endif
+    return sample;
+}
+
+bool PerfCounters::any() const {
+    for (const auto fd : fds_) {
+        if (fd >= 0) return true;
+    }
+    return false;
+}
+
+PhaseProfiler::Start PhaseProfiler::begin() const {
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return {std::chrono::duration_cast<std::chrono::nanoseconds>(now).count(), counters_.read()};
+}
+
+void PhaseProfiler::end(const std::string& name, const Start& start) {
+    const auto finish = begin();
+    PhaseStats stats{name, static_cast<double>(finish.nanoseconds - start.nanoseconds) / 1e6, {}};
+    for (size_t c = 0; c < COUNTER_COUNT; ++c) {
+        if (start.counters[c] && finish.counters[c]) stats.counters[c] = *finish.counters[c] - *start.counters[c];
+    }
+    phases_.push_back(std::move(stats));
+}
+
+void PhaseProfiler::print(std::ostream& out) const {
+    const utils::StreamFormatGuard guard(out);
+
+    if (!counters_.any()) {
+        out << "Hardware counters unavailable (" << counters_.error() << "), wall time only\n";
+    } else if (!counters_.error().empty()) {
+        out << "Some counters unavailable (" << counters_.error() << ")\n";
+    }
+
+    out << std::left << std::setw(16) << "phase" << std::right << std::setw(10) << "ms";
+    for (size_t c = 0; c < COUNTER_COUNT; ++c) {
+        out << std::setw(14) << COUNTER_NAMES[c];
+        if (c == static_cast<size_t>(Counter::INSTRUCTIONS)) out << std::setw(7) << "IPC";
+    }
+    out << "\n";
+
+    double milliseconds = 0;
+    CounterSample totals;
+    for (const auto& phase : phases_) {
+        print_row(out, phase.name, phase.milliseconds, phase.counters);
+        milliseconds += phase.milliseconds;
+    }
+    for (size_t c = 0; c < COUNTER_COUNT; ++c) totals[c] = total(phases_, c);
+    print_row(out, "total", milliseconds, totals);
+
+    if (instructions_ == 0 || !counters_.any()) return;
+    out << "Per instruction assembled (" << instructions_ << "):";
+    auto first = true;
+    for (const auto counter : {Counter::CYCLES, Counter::BRANCH_MISSES, Counter::L1D_MISSES, Counter::LLC_MISSES,
+                               Counter::PAGE_FAULTS}) {
+        const auto& value = totals[static_cast<size_t>(counter)];
+        if (!value) continue;
+        out << (first ? " " : ", ") << std::fixed << std::setprecision(3)
+            << static_cast<double>(*value) / static_cast<double>(instructions_) << " "
+            << COUNTER_NAMES[static_cast<size_t>(counter)];
+        first = false;
+    }
+    out << "\n";
+}
@@ -0,0 +1,99 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+enum class Counter {
+    CYCLES,
+    INSTRUCTIONS,
+    BRANCH_MISSES,
+    L1D_MISSES,
+    LLC_MISSES,
+    PAGE_FAULTS
+};
+
+inline constexpr size_t COUNTER_COUNT = 6;
+
+// one value per Counter; nullopt where the counter could not be opened
+using CounterSample = std::array<std::optional<uint64_t>, COUNTER_COUNT>;
+
+// Linux perf_event_open counters for the calling thread and the threads it
+// starts afterwards, user space only so they work without privileges; each is
+// opened on its own, so a CPU or VM lacking some still reports the others.
+// Elsewhere nothing opens and every read is empty.
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // totals since construction, scaled up when the kernel had to multiplex
+    [[nodiscard]] CounterSample read() const;
+    [[nodiscard]] bool any() const;
+    // why the first refused counter was refused
+    [[nodiscard]] const std::string& error() const { return error_; }
+
+private:
+    std::array<int, COUNTER_COUNT> fds_;
+    std::string error_;
+};
+
+struct PhaseStats {
+    std::string name;
+    double milliseconds = 0;
+    CounterSample counters; // deltas over the phase
+};
+
+// wall time and counter deltas for each phase of one assembly
+class PhaseProfiler {
+public:
+    template <typename F>
+    decltype(auto) measure(const std::string& name, F&& phase) {
+        const auto start = begin();
+        struct End {
+            PhaseProfiler& profiler;
+            const std::string& name;
+            const Start& start;
+            ~End() { profiler.end(name, start); }
+        } end{*this, name, start};
+        return phase();
+    }
+
+    // what the per-instruction figures are divided by
+    void set_instructions(const size_t instructions) { instructions_ = instructions; }
+
+    [[nodiscard]] const std::vector<PhaseStats>& phases() const { return phases_; }
+    void print(std::ostream& out) const;
+
+private:
+    struct Start {
+        int64_t nanoseconds;
+        CounterSample counters;
+    };
+
+    Start begin() const;
+    void end(const std::string& name, const Start& start);
+
+    PerfCounters counters_;
+    std::vector<PhaseStats> phases_;
+    size_t instructions_ = 0;
+};
+
+// runs phase, measured when a profiler is given
+template <typename F>
+decltype(auto) measured(PhaseProfiler* profiler, const std::string& name, F&& phase) {
+    if (profiler) return profiler->measure(name, std::forward<F>(phase));
+    return phase();
+}
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,264 @@
+#include "preprocessor.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+
+bool uses_preprocessor(const std::string_view text) {
+    return text.find(".include") != std::string_view::npos || text.find(".macro") != std::string_view::npos ||
+           text.find(".endm") != std::string_view::npos;
+}
+
+std::shared_ptr<const Fragment> FragmentCache::get(const std::string& path, const TargetCore core) {
+    std::unique_ptr<MappedFile> file;
+    try {
+        file = std::make_unique<MappedFile>(path);
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+    const std::string_view text(reinterpret_cast<const char*>(file->data()), file->size());
+    const auto hash = std::hash<std::string_view>{}(text);
+    auto& entries = entries_[static_cast<size_t>(core)];
+
+    {
+        std::lock_guard lock(mutex_);
+        const auto it = entries.find(path);
+        if (it != entries.end() && it->second.size == text.size() && it->second.hash == hash) {
+            return it->second.fragment;
+        }
+    }
+
+    // lex outside the lock; concurrent misses on the same path just race to store
+    auto fragment = std::make_shared<Fragment>();
+    Lexer lexer(std::string(text), fragment->symbols, core);
+    for (auto token = lexer.next_token(); token.type != TokenType::EoF; token = lexer.next_token()) {
+        fragment->tokens.push_back(std::move(token));
+    }
+
+    std::lock_guard lock(mutex_);
+    entries[path] = {text.size(), hash, fragment};
+    return fragment;
+}
+
+Preprocessor::Preprocessor(Lexer& lexer, FragmentCache* fragments, std::vector<std::string>* included)
+    : lexer_(lexer), fragments_(fragments ? fragments : &own_fragments_), included_(included) {
+    frames_.emplace_back();
+}
+
+Token Preprocessor::next_token() {
+    while (true) {
+        auto token = take();
+        if (token.type == TokenType::DOT) {
+            if (const auto* keyword = peek(0); keyword && keyword->type == TokenType::IDENT) {
+                if (keyword->literal == "include") {
+                    take();
+                    include(token);
+                    continue;
+                }
+                if (keyword->literal == "macro") {
+                    take();
+                    define(token);
+                    continue;
+                }
+                if (keyword->literal == "endm") {
+                    throw std::runtime_error(".endm without .macro at line " + std::to_string(source_line(token)));
+                }
+            }
+        } else if (token.type == TokenType::IDENT && statement_start_ && !macros_.empty()) {
+            // a label of the same name is not a call
+            if (const auto it = macros_.find(token.literal); it != macros_.end()) {
+                if (const auto* next = peek(0); !next || next->type != TokenType::COLON) {
+                    call(it->first, it->second, token);
+                    continue;
+                }
+            }
+        }
+        if (frames_.size() > 1) token.line = expansion_line_;
+        return token;
+    }
+}
+
+Token Preprocessor::take() {
+    while (frames_.size() > 1 && frames_.back().pos == tokens_of(frames_.back()).size()) frames_.pop_back();
+
+    auto& frame = frames_.back();
+    auto token = frames_.size() == 1 ? lex() : frame_token(frame);
+    // there are no newline tokens: a statement starts on a new line or after a label
+    statement_start_ = token.line != frame.previous_line || frame.previous_type == TokenType::COLON;
+    frame.previous_type = token.type;
+    frame.previous_line = token.line;
+    return token;
+}
+
+Token Preprocessor::lex() {
+    if (pending_.empty()) return lexer_.next_token();
+    auto token = std::move(pending_[next_pending_++]);
+    if (next_pending_ == pending_.size()) {
+        pending_.clear();
+        next_pending_ = 0;
+    }
+    return token;
+}
+
+Token Preprocessor::frame_token(Frame& frame) {
+    auto token = tokens_of(frame)[frame.pos++];
+    if (frame.remap && token.symbol != NO_SYMBOL) {
+        auto& ours = (*frame.remap)[token.symbol];
+        if (ours == NO_SYMBOL) ours = symbols()->intern(frame.fragment->symbols->name(token.symbol));
+        token.symbol = ours;
+    }
+    return token;
+}
+
+// the symbols of tokens peeked in an included file are still the fragment's
+const Token* Preprocessor::peek(const size_t k) {
+    if (frames_.size() == 1) {
+        while (pending_.size() <= next_pending_ + k) pending_.push_back(lexer_.next_token());
+        const auto& token = pending_[next_pending_ + k];
+        return token.type == TokenType::EoF ? nullptr : &token;
+    }
+    const auto& frame = frames_.back();
+    const auto& tokens = tokens_of(frame);
+    return frame.pos + k < tokens.size() ? &tokens[frame.pos + k] : nullptr;
+}
+
+const std::vector<Token>& Preprocessor::tokens_of(const Frame& frame) const {
+    return frame.fragment ? frame.fragment->tokens : frame.expansion;
+}
+
+int Preprocessor::source_line(const Token& token) const {
+    return frames_.size() > 1 ? expansion_line_ : token.line;
+}
+
+void Preprocessor::push(Frame frame, const int line) {
+    if (frames_.size() == 1) expansion_line_ = line;
+    frames_.push_back(std::move(frame));
+}
+
+void Preprocessor::include(const Token& directive) {
+    const auto line = std::to_string(source_line(directive));
+    if (const auto* path = peek(0); !path || path->type != TokenType::STRING) {
+        throw std::runtime_error("Expected quoted file name after .include at line " + line);
+    }
+    auto path = take().literal;
+    for (const auto& frame : frames_) {
+        if (!frame.macro && frame.name == path) {
+            throw std::runtime_error("Recursive .include of " + path + " at line " + line);
+        }
+    }
+
+    if (included_ && std::ranges::find(*included_, path) == included_->end()) included_->push_back(path);
+    auto fragment = fragments_->get(path, lexer_.core());
+    if (!fragment) throw std::runtime_error("Failed to open included file: " + path + " at line " + line);
+    auto& remap = remaps_[fragment.get()];
+    if (!remap.fragment) {
+        remap.fragment = fragment;
+        remap.ids.assign(fragment->symbols->size(), NO_SYMBOL);
+    }
+
+    Frame frame;
+    frame.fragment = std::move(fragment);
+    frame.name = std::move(path);
+    frame.remap = &remap.ids;
+    push(std::move(frame), directive.line);
+}
+
+void Preprocessor::define(const Token& directive) {
+    const auto line = std::to_string(source_line(directive));
+    if (const auto* name = peek(0); !name || name->type != TokenType::IDENT) {
+        throw std::runtime_error("Expected macro name after .macro at line " + line);
+    }
+    const auto name = take();
+    if (macros_.contains(name.literal)) {
+        throw std::runtime_error("Macro '" + name.literal + "' is already defined, at line " + line);
+    }
+
+    Macro macro;
+    // the parameters are the identifiers on the rest of the line
+    for (const Token* next; (next = peek(0)) && next->type == TokenType::IDENT && next->line == name.line;) {
+        macro.parameters.push_back(take().literal);
+        if ((next = peek(0)) && next->type == TokenType::COMMA && next->line == name.line) take();
+    }
+
+    auto after_dot = false;
+    while (true) {
+        const auto* next = peek(0);
+        if (!next) throw std::runtime_error("Missing .endm for macro '" + name.literal + "' at line " + line);
+        if (next->type == TokenType::DOT) {
+            if (const auto* keyword = peek(1); keyword && keyword->type == TokenType::IDENT) {
+                if (keyword->literal == "endm") {
+                    take();
+                    take();
+                    break;
+                }
+                if (keyword->literal == "macro") {
+                    throw std::runtime_error("Nested .macro in macro '" + name.literal + "' at line " + line);
+                }
+            }
+        }
+        auto token = take();
+        // ".data:" is a directive, not a label
+        if (token.type == TokenType::IDENT && !after_dot) {
+            if (const auto* colon = peek(0); colon && colon->type == TokenType::COLON) macro.labels.insert(token.literal);
+        }
+        after_dot = token.type == TokenType::DOT;
+        macro.body.push_back(std::move(token));
+    }
+    macros_.emplace(name.literal, std::move(macro));
+}
+
+void Preprocessor::call(const std::string& name, const Macro& macro, const Token& call) {
+    const auto line = std::to_string(source_line(call));
+    for (const auto& frame : frames_) {
+        if (frame.macro && frame.name == name) {
+            throw std::runtime_error("Recursive call of macro '" + name + "' at line " + line);
+        }
+    }
+
+    // the arguments run to the end of the line, separated by commas
+    std::vector<std::vector<Token>> arguments;
+    for (const Token* next; (next = peek(0)) && next->line == call.line;) {
+        auto token = take();
+        if (arguments.empty()) arguments.emplace_back();
+        if (token.type == TokenType::COMMA) {
+            arguments.emplace_back();
+        } else {
+            arguments.back().push_back(std::move(token));
+        }
+    }
+    const auto& parameters = macro.parameters;
+    if (arguments.size() != parameters.size()) {
+        throw std::runtime_error("Macro '" + name + "' expects " + std::to_string(parameters.size()) +
+                                 " argument(s), got " + std::to_string(arguments.size()) + " at line " + line);
+    }
+    if (std::any_of(arguments.begin(), arguments.end(), [](const auto& argument) { return argument.empty(); })) {
+        throw std::runtime_error("Empty argument to macro '" + name + "' at line " + line);
+    }
+
+    const auto suffix = "@" + std::to_string(++expansions_);
+    Frame frame;
+    frame.name = name;
+    frame.macro = true;
+    frame.expansion.reserve(macro.body.size());
+    for (const auto& token : macro.body) {
+        if (token.type == TokenType::IDENT) {
+            if (const auto parameter = std::find(parameters.begin(), parameters.end(), token.literal);
+                parameter != parameters.end()) {
+                // keep the body's lines, so calls nested in it still see their statements
+                for (auto argument : arguments[parameter - parameters.begin()]) {
+                    argument.line = token.line;
+                    frame.expansion.push_back(std::move(argument));
+                }
+                continue;
+            }
+            if (macro.labels.contains(token.literal)) {
+                frame.expansion.push_back(renamed(token, token.literal + suffix, *symbols()));
+                continue;
+            }
+        }
+        frame.expansion.push_back(token);
+    }
+    push(std::move(frame), call.line);
+}
@@ -0,0 +1,117 @@
+#ifndef PREPROCESSOR_H
+#define PREPROCESSOR_H
+
+
+#include "lexer.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+// the tokens of an included file, lexed without expanding anything. A fragment
+// outlives the assembly that first included it, so its identifiers are interned
+// into a table of its own and mapped to the includer's IDs when spliced in
+struct Fragment {
+    std::vector<Token> tokens; // without the EoF
+    std::shared_ptr<SymbolInterner> symbols = std::make_shared<SymbolInterner>();
+};
+
+// lexed include files shared between assemblies; an entry is lexed again when
+// the file's contents no longer match the hash it was lexed from
+class FragmentCache {
+public:
+    // an empty pointer when the file cannot be read; lexed for core, which decides
+    // whether the extended mnemonics are instructions
+    std::shared_ptr<const Fragment> get(const std::string& path, TargetCore core);
+
+private:
+    struct Entry {
+        size_t size;
+        size_t hash;
+        std::shared_ptr<const Fragment> fragment;
+    };
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_[2]; // by TargetCore
+};
+
+// expands includes and macros between the lexer and the parser:
+//   .include "file"             the file's statements, as if written in its place
+//   .macro name [p1[, p2...]]   defines name, with the body up to .endm
+//   name [a1[, a2...]]          at the start of a statement: the body, each parameter
+//                               replaced by the tokens of its argument
+// arguments run to the end of the line. Labels defined in a macro body are local
+// to each expansion. Expanded tokens carry the line of the outermost .include or
+// call, so errors and reports point into the file being assembled
+class Preprocessor final : public TokenSource {
+public:
+    // included files come from fragments, or from a cache of the preprocessor's own;
+    // the path of each is appended to included once, if set, even when it cannot be read
+    explicit Preprocessor(Lexer& lexer, FragmentCache* fragments = nullptr,
+                          std::vector<std::string>* included = nullptr);
+
+    Token next_token() override;
+    [[nodiscard]] const std::shared_ptr<SymbolInterner>& symbols() const override { return lexer_.symbols(); }
+
+private:
+    struct Macro {
+        std::vector<std::string> parameters;
+        std::vector<Token> body;
+        std::unordered_set<std::string> labels; // defined in the body
+    };
+
+    struct Remap {
+        std::shared_ptr<const Fragment> fragment; // keeps the key alive
+        std::vector<uint32_t> ids;                // fragment symbol to ours, NO_SYMBOL until first use
+    };
+
+    // the lexer at the bottom, then one per .include or call being expanded
+    struct Frame {
+        std::shared_ptr<const Fragment> fragment;
+        std::vector<Token> expansion;
+        std::string name;               // path or macro name, to refuse recursion
+        bool macro = false;
+        size_t pos = 0;
+        std::vector<uint32_t>* remap = nullptr;
+        // the last token taken, to tell where a statement starts
+        TokenType previous_type = TokenType::EoF;
+        int previous_line = 0;
+    };
+
+    // the next raw token of the innermost frame, after popping exhausted ones
+    Token take();
+    Token lex();
+    Token frame_token(Frame& frame);
+    // the token k ahead in the innermost frame; null past its end
+    const Token* peek(size_t k);
+    [[nodiscard]] const std::vector<Token>& tokens_of(const Frame& frame) const;
+    [[nodiscard]] int source_line(const Token& token) const;
+    void push(Frame frame, int line);
+
+    void include(const Token& directive);
+    void define(const Token& directive);
+    void call(const std::string& name, const Macro& macro, const Token& call);
+
+    Lexer& lexer_;
+    FragmentCache own_fragments_;
+    FragmentCache* fragments_;
+    std::vector<std::string>* included_;
+    std::vector<Token> pending_; // peeked from the lexer, taken from next_pending_ on
+    size_t next_pending_ = 0;
+    std::vector<Frame> frames_;
+    int expansion_line_ = 0;    // stamped on the tokens of every frame above the lexer
+    bool statement_start_ = true; // whether the last token taken begins a statement
+    std::unordered_map<std::string, Macro> macros_;
+    std::unordered_map<const Fragment*, Remap> remaps_;
+    size_t expansions_ = 0;
+};
+
+// false when text cannot use .include or .macro, so its tokens can go straight to the parser
+bool uses_preprocessor(std::string_view text);
+
+#endif // PREPROCESSOR_H
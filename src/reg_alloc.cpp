@@ -0,0 +1,316 @@
+#include "reg_alloc.h"
+#include "cfg.h"
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+
+namespace {
+
+// jal writes the return address to register 31
+constexpr std::string_view LINK_REGISTER = "t7";
+
+struct Operands {
+    std::vector<std::string*> uses;
+    std::vector<std::string*> defs;
+};
+
+// register fields of an instruction; shift amounts and empty bases are filtered by the caller
+Operands operands_of(Node* node) {
+    Operands ops;
+    if (auto* r_inst = dynamic_cast<RTypeInst*>(node)) {
+        ops.uses = {&r_inst->rs, &r_inst->rt};
+        ops.defs = {&r_inst->rd};
+    } else if (auto* i_inst = dynamic_cast<ITypeInst*>(node)) {
+        const auto& mnemonic = i_inst->mnemonic;
+        if (mnemonic == "sw" || mnemonic == "beq" || mnemonic == "bne") {
+            ops.uses = {&i_inst->rs, &i_inst->rt};
+        } else {
+            ops.uses = {&i_inst->rs};
+            ops.defs = {&i_inst->rt};
+        }
+    }
+    return ops;
+}
+
+struct Interval {
+    size_t vreg;
+    size_t start;
+    size_t end;
+};
+
+// linear scan over intervals sorted by start; returns the register index per
+// virtual register, or nullopt for the spilled ones
+std::vector<std::optional<size_t>> linear_scan(const std::vector<Interval>& intervals, const size_t vreg_count,
+                                               const size_t register_count) {
+    std::vector<std::optional<size_t>> assigned(vreg_count);
+    std::set<size_t> free;
+    for (size_t reg = 0; reg < register_count; ++reg) free.insert(reg);
+
+    std::vector<const Interval*> active; // sorted by end
+    auto activate = [&](const Interval* interval) {
+        const auto pos = std::upper_bound(active.begin(), active.end(), interval, [](auto* a, auto* b) {
+            return a->end < b->end;
+        });
+        active.insert(pos, interval);
+    };
+
+    for (const auto& current : intervals) {
+        // a register is reusable once its interval ended strictly before this one starts
+        while (!active.empty() && active.front()->end < current.start) {
+            free.insert(*assigned[active.front()->vreg]);
+            active.erase(active.begin());
+        }
+
+        if (!free.empty()) {
+            assigned[current.vreg] = *free.begin();
+            free.erase(free.begin());
+            activate(&current);
+        } else if (!active.empty() && active.back()->end > current.end) {
+            // spill whichever lives longest
+            const auto* victim = active.back();
+            active.pop_back();
+            assigned[current.vreg] = assigned[victim->vreg];
+            assigned[victim->vreg] = std::nullopt;
+            activate(&current);
+        }
+    }
+    return assigned;
+}
+
+std::unique_ptr<ITypeInst> make_spill(const std::string& mnemonic, const std::string& reg,
+                                      const std::string& slot, SymbolInterner& symbols, const int line) {
+    auto inst = std::make_unique<ITypeInst>();
+    inst->mnemonic = mnemonic;
+    inst->rt = reg;
+    inst->set_label(slot, symbols);
+    inst->line = line;
+    return inst;
+}
+
+}
+
+RegAllocReport allocate_registers(AST& ast) {
+    RegAllocReport report;
+
+    std::unordered_map<std::string, size_t> vreg_ids;
+    std::vector<std::string> vreg_names;
+    // register 0 and r0 are what programs use as the zero register
+    std::unordered_set<std::string> taken { "a0", "r0" };
+
+    for (const auto& node : ast.nodes) {
+        if (const auto* j_inst = dynamic_cast<const JTypeInst*>(node.get()); j_inst && j_inst->mnemonic == "jal") {
+            taken.emplace(LINK_REGISTER);
+        }
+
+        auto ops = operands_of(node.get());
+        ops.uses.insert(ops.uses.end(), ops.defs.begin(), ops.defs.end());
+        for (const auto* reg : ops.uses) {
+            if (is_virtual_register(*reg)) {
+                if (vreg_ids.try_emplace(*reg, vreg_names.size()).second) vreg_names.push_back(*reg);
+            } else if (REG_MAP.contains(*reg)) {
+                taken.insert(*reg);
+            }
+        }
+    }
+    report.virtual_registers = vreg_names.size();
+    if (vreg_names.empty()) return report;
+
+    const ControlFlowGraph cfg(ast);
+    const auto& blocks = cfg.blocks();
+    const auto vreg_count = vreg_names.size();
+
+    // number the instructions in program order and collect per-block use/def sets
+    std::vector<size_t> first_pos(blocks.size()), last_pos(blocks.size());
+    std::vector<std::vector<bool>> use(blocks.size(), std::vector<bool>(vreg_count, false));
+    std::vector<std::vector<bool>> def = use;
+    std::vector<Interval> intervals(vreg_count);
+    for (size_t v = 0; v < vreg_count; ++v) intervals[v] = {v, SIZE_MAX, 0};
+
+    size_t pos = 0;
+    for (size_t id = 0; id < blocks.size(); ++id) {
+        first_pos[id] = pos;
+        for (const auto idx : blocks[id].nodes) {
+            auto* node = ast.nodes[idx].get();
+            if (node->type != NodeType::INSTRUCTION) continue;
+
+            const auto ops = operands_of(node);
+            for (const auto* reg : ops.uses) {
+                const auto it = vreg_ids.find(*reg);
+                if (it == vreg_ids.end()) continue;
+                if (!def[id][it->second]) use[id][it->second] = true;
+                intervals[it->second].start = std::min(intervals[it->second].start, pos);
+                intervals[it->second].end = std::max(intervals[it->second].end, pos);
+            }
+            for (const auto* reg : ops.defs) {
+                const auto it = vreg_ids.find(*reg);
+                if (it == vreg_ids.end()) continue;
+                def[id][it->second] = true;
+                intervals[it->second].start = std::min(intervals[it->second].start, pos);
+                intervals[it->second].end = std::max(intervals[it->second].end, pos);
+            }
+            ++pos;
+        }
+        last_pos[id] = pos; // one past the block's last instruction
+    }
+
+    // backward liveness until fixpoint
+    std::vector<std::vector<bool>> live_in(blocks.size(), std::vector<bool>(vreg_count, false));
+    std::vector<std::vector<bool>> live_out = live_in;
+    auto changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t id = blocks.size(); id-- > 0;) {
+            std::vector<bool> out(vreg_count, false);
+            for (const auto succ : {blocks[id].taken, blocks[id].fall_through}) {
+                if (!succ) continue;
+                for (size_t v = 0; v < vreg_count; ++v) out[v] = out[v] || live_in[*succ][v];
+            }
+            std::vector<bool> in(vreg_count);
+            for (size_t v = 0; v < vreg_count; ++v) in[v] = use[id][v] || (out[v] && !def[id][v]);
+            if (in != live_in[id] || out != live_out[id]) {
+                live_in[id] = std::move(in);
+                live_out[id] = std::move(out);
+                changed = true;
+            }
+        }
+    }
+
+    // widen each interval over the blocks it is live through
+    for (size_t id = 0; id < blocks.size(); ++id) {
+        if (first_pos[id] == last_pos[id]) continue;
+        for (size_t v = 0; v < vreg_count; ++v) {
+            if (live_in[id][v]) intervals[v].start = std::min(intervals[v].start, first_pos[id]);
+            if (live_out[id][v]) intervals[v].end = std::max(intervals[v].end, last_pos[id] - 1);
+        }
+    }
+    std::sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b) {
+        return a.start != b.start ? a.start < b.start : a.vreg < b.vreg;
+    });
+
+    std::vector<std::string> free;
+    std::vector<std::pair<std::string_view, uint32_t>> by_number(REG_MAP.begin(), REG_MAP.end());
+    std::sort(by_number.begin(), by_number.end(), [](auto& a, auto& b) { return a.second < b.second; });
+    for (const auto& [name, num] : by_number) {
+        if (!taken.contains(std::string(name))) free.emplace_back(name);
+    }
+
+    auto assigned = linear_scan(intervals, vreg_count, free.size());
+    std::vector<std::string> scratch;
+    if (std::ranges::any_of(assigned, [](auto& reg) { return !reg; })) {
+        // spill code needs two registers of its own for the operands
+        if (free.size() < 2) {
+            throw std::runtime_error("Not enough free physical registers to allocate virtual registers");
+        }
+        scratch.assign(free.end() - 2, free.end());
+        free.resize(free.size() - 2);
+        assigned = linear_scan(intervals, vreg_count, free.size());
+    }
+
+    // spill slots must not collide with the program's labels
+    std::unordered_set<std::string> names;
+    if (std::ranges::any_of(assigned, [](const auto& slot) { return !slot; })) {
+        for (const auto& node : ast.nodes) {
+            if (const auto* label = dynamic_cast<const LabelNode*>(node.get())) names.insert(label->name);
+        }
+    }
+
+    std::vector<std::string> allocation(vreg_count);
+    size_t next_slot = 0;
+    for (size_t v = 0; v < vreg_count; ++v) {
+        if (assigned[v]) {
+            allocation[v] = free[*assigned[v]];
+            continue;
+        }
+        do {
+            allocation[v] = "__spill" + std::to_string(next_slot++);
+        } while (names.contains(allocation[v]));
+        report.spilled++;
+    }
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    nodes.reserve(ast.nodes.size());
+    for (auto& node : ast.nodes) {
+        if (node->type != NodeType::INSTRUCTION) {
+            nodes.push_back(std::move(node));
+            continue;
+        }
+
+        const auto ops = operands_of(node.get());
+        std::vector<std::pair<size_t, std::string>> loaded; // spilled vreg -> scratch register
+        std::optional<std::pair<std::string, std::string>> store;
+        auto scratch_for = [&](const size_t v) -> std::string {
+            for (const auto& [vreg, reg] : loaded) {
+                if (vreg == v) return reg;
+            }
+            return scratch[0];
+        };
+
+        for (auto* reg : ops.uses) {
+            const auto it = vreg_ids.find(*reg);
+            if (it == vreg_ids.end()) continue;
+            const auto v = it->second;
+            if (!assigned[v]) {
+                if (std::ranges::none_of(loaded, [&](auto& entry) { return entry.first == v; })) {
+                    loaded.emplace_back(v, scratch[loaded.size()]);
+                    nodes.push_back(make_spill("lw", loaded.back().second, allocation[v], *ast.symbols,
+                                               node->line));
+                    report.spill_instructions++;
+                }
+                *reg = scratch_for(v);
+            } else {
+                *reg = allocation[v];
+            }
+        }
+        for (auto* reg : ops.defs) {
+            const auto it = vreg_ids.find(*reg);
+            if (it == vreg_ids.end()) continue;
+            const auto v = it->second;
+            if (!assigned[v]) {
+                // sources are read before the destination is written, so a scratch can be shared
+                *reg = scratch_for(v);
+                store.emplace(*reg, allocation[v]);
+            } else {
+                *reg = allocation[v];
+            }
+        }
+
+        const auto line = node->line;
+        nodes.push_back(std::move(node));
+        if (store) {
+            nodes.push_back(make_spill("sw", store->first, store->second, *ast.symbols, line));
+            report.spill_instructions++;
+        }
+    }
+
+    if (report.spilled > 0) {
+        auto data_dir = std::make_unique<DirectiveNode>();
+        data_dir->name = "data";
+        nodes.push_back(std::move(data_dir));
+        for (size_t v = 0; v < vreg_count; ++v) {
+            if (assigned[v]) continue;
+            auto label = std::make_unique<LabelNode>();
+            label->set_name(allocation[v], *ast.symbols);
+            nodes.push_back(std::move(label));
+            auto word = std::make_unique<DirectiveNode>();
+            word->name = "word";
+            word->values = {"0"};
+            nodes.push_back(std::move(word));
+        }
+    }
+    ast.nodes = std::move(nodes);
+
+    for (size_t v = 0; v < vreg_count; ++v) report.assignments.emplace_back(vreg_names[v], allocation[v]);
+    return report;
+}
+
+void print_report(std::ostream& out, const RegAllocReport& report) {
+    out << "Register allocation: " << report.virtual_registers << " virtual register(s), "
+        << report.spilled << " spilled, " << report.spill_instructions << " spill instruction(s)\n";
+    for (const auto& [vreg, target] : report.assignments) {
+        out << "  $" << vreg << " -> " << (REG_MAP.contains(target) ? "$" : "") << target << '\n';
+    }
+}
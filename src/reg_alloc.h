@@ -0,0 +1,27 @@
+#ifndef REG_ALLOC_H
+#define REG_ALLOC_H
+
+
+#include "parser.h"
+
+#include <ostream>
+#include <utility>
+#include <vector>
+
+
+struct RegAllocReport {
+    size_t virtual_registers = 0;
+    size_t spilled = 0;
+    size_t spill_instructions = 0; // lw/sw inserted around the uses and definitions
+    std::vector<std::pair<std::string, std::string>> assignments; // virtual -> physical, or spill slot
+};
+
+// maps the virtual registers ($v0, $v1, ...) onto the physical registers the
+// program never names, with a linear scan over live intervals computed on the
+// CFG. what does not fit is kept in .data slots, loaded and stored through
+// two reserved scratch registers
+RegAllocReport allocate_registers(AST& ast);
+
+void print_report(std::ostream& out, const RegAllocReport& report);
+
+#endif // REG_ALLOC_H
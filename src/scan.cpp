@@ -0,0 +1,247 @@
+#include "scan.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+// SSE2 is part of x86-64; AVX2 is compiled per function and only used when the CPU has it
+#if defined(__x86_64__) || defined(_M_X64)
+#define SCAN_SSE2 1
+#include <immintrin.h>
+#endif
+#if defined(SCAN_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define SCAN_AVX2 1
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+
+namespace scan {
+namespace {
+
+bool is_space(const unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+bool is_ident(const unsigned char c) {
+    return static_cast<unsigned>((c | 0x20) - 'a') < 26 || static_cast<unsigned>(c - '0') < 10 || c == '_';
+}
+
+size_t skip_space_scalar(const char* data, size_t pos, const size_t size) {
+    while (pos < size && is_space(static_cast<unsigned char>(data[pos]))) ++pos;
+    return pos;
+}
+
+size_t skip_ident_scalar(const char* data, size_t pos, const size_t size) {
+    while (pos < size && is_ident(static_cast<unsigned char>(data[pos]))) ++pos;
+    return pos;
+}
+
+size_t find_line_end_scalar(const char* data, const size_t pos, const size_t size) {
+    if (pos >= size) return size;
+    const auto* newline = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+    const auto end = newline ? static_cast<size_t>(newline - data) : size;
+    const auto* nul = static_cast<const char*>(std::memchr(data + pos, '\0', end - pos));
+    return nul ? static_cast<size_t>(nul - data) : end;
+}
+
+size_t count_newlines_scalar(const char* data, const size_t begin, const size_t end) {
+    return static_cast<size_t>(std::count(data + begin, data + end, '\n'));
+}
+
+#ifdef SCAN_SSE2
+
+// per byte, all ones where the class matches
+__m128i space_mask(const __m128i bytes) {
+    const auto tab_to_cr = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('\t' - 1)),
+                                         _mm_cmpgt_epi8(_mm_set1_epi8('\r' + 1), bytes));
+    return _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')), tab_to_cr);
+}
+
+// bytes of 0x80 and above compare as negative, so they match neither range
+__m128i ident_mask(const __m128i bytes) {
+    const auto lower = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+    const auto letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                      _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), lower));
+    const auto digit = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('0' - 1)),
+                                     _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), bytes));
+    return _mm_or_si128(_mm_or_si128(letter, digit), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')));
+}
+
+__m128i load16(const char* data, const size_t pos) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+}
+
+size_t skip_space_sse2(const char* data, size_t pos, const size_t size) {
+    for (; pos + 16 <= size; pos += 16) {
+        const auto other = ~static_cast<unsigned>(_mm_movemask_epi8(space_mask(load16(data, pos)))) & 0xFFFF;
+        if (other) return pos + std::countr_zero(other);
+    }
+    return skip_space_scalar(data, pos, size);
+}
+
+size_t skip_ident_sse2(const char* data, size_t pos, const size_t size) {
+    for (; pos + 16 <= size; pos += 16) {
+        const auto other = ~static_cast<unsigned>(_mm_movemask_epi8(ident_mask(load16(data, pos)))) & 0xFFFF;
+        if (other) return pos + std::countr_zero(other);
+    }
+    return skip_ident_scalar(data, pos, size);
+}
+
+size_t find_line_end_sse2(const char* data, size_t pos, const size_t size) {
+    for (; pos + 16 <= size; pos += 16) {
+        const auto bytes = load16(data, pos);
+        const auto end = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(bytes, _mm_setzero_si128()));
+        if (const auto mask = static_cast<unsigned>(_mm_movemask_epi8(end))) return pos + std::countr_zero(mask);
+    }
+    return find_line_end_scalar(data, pos, size);
+}
+
+size_t count_newlines_sse2(const char* data, size_t begin, const size_t end) {
+    size_t count = 0;
+    for (; begin + 16 <= end; begin += 16) {
+        const auto newline = _mm_cmpeq_epi8(load16(data, begin), _mm_set1_epi8('\n'));
+        count += std::popcount(static_cast<unsigned>(_mm_movemask_epi8(newline)));
+    }
+    return count + count_newlines_scalar(data, begin, end);
+}
+
+#endif
+
+#ifdef SCAN_AVX2
+
+AVX2_TARGET __m256i space_mask_avx2(const __m256i bytes) {
+    const auto tab_to_cr = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('\t' - 1)),
+                                            _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), bytes));
+    return _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')), tab_to_cr);
+}
+
+AVX2_TARGET __m256i ident_mask_avx2(const __m256i bytes) {
+    const auto lower = _mm256_or_si256(bytes, _mm256_set1_epi8(0x20));
+    const auto letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+    const auto digit = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('0' - 1)),
+                                        _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), bytes));
+    return _mm256_or_si256(_mm256_or_si256(letter, digit), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_')));
+}
+
+AVX2_TARGET __m256i load32(const char* data, const size_t pos) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+}
+
+AVX2_TARGET size_t skip_space_avx2(const char* data, size_t pos, const size_t size) {
+    for (; pos + 32 <= size; pos += 32) {
+        const auto other = ~static_cast<uint32_t>(_mm256_movemask_epi8(space_mask_avx2(load32(data, pos))));
+        if (other) return pos + std::countr_zero(other);
+    }
+    return skip_space_sse2(data, pos, size);
+}
+
+AVX2_TARGET size_t skip_ident_avx2(const char* data, size_t pos, const size_t size) {
+    for (; pos + 32 <= size; pos += 32) {
+        const auto other = ~static_cast<uint32_t>(_mm256_movemask_epi8(ident_mask_avx2(load32(data, pos))));
+        if (other) return pos + std::countr_zero(other);
+    }
+    return skip_ident_sse2(data, pos, size);
+}
+
+AVX2_TARGET size_t find_line_end_avx2(const char* data, size_t pos, const size_t size) {
+    for (; pos + 32 <= size; pos += 32) {
+        const auto bytes = load32(data, pos);
+        const auto end = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')),
+                                         _mm256_cmpeq_epi8(bytes, _mm256_setzero_si256()));
+        if (const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(end))) return pos + std::countr_zero(mask);
+    }
+    return find_line_end_sse2(data, pos, size);
+}
+
+AVX2_TARGET size_t count_newlines_avx2(const char* data, size_t begin, const size_t end) {
+    size_t count = 0;
+    for (; begin + 32 <= end; begin += 32) {
+        const auto newline = _mm256_cmpeq_epi8(load32(data, begin), _mm256_set1_epi8('\n'));
+        count += std::popcount(static_cast<uint32_t>(_mm256_movemask_epi8(newline)));
+    }
+    return count + count_newlines_sse2(data, begin, end);
+}
+
+#endif
+
+struct Kernels {
+    Level level;
+    size_t (*skip_space)(const char*, size_t, size_t);
+    size_t (*skip_ident)(const char*, size_t, size_t);
+    size_t (*find_line_end)(const char*, size_t, size_t);
+    size_t (*count_newlines)(const char*, size_t, size_t);
+};
+
+constexpr Kernels SCALAR_KERNELS{
+    Level::SCALAR, skip_space_scalar, skip_ident_scalar, find_line_end_scalar, count_newlines_scalar
+};
+#ifdef SCAN_SSE2
+constexpr Kernels SSE2_KERNELS{Level::SSE2, skip_space_sse2, skip_ident_sse2, find_line_end_sse2, count_newlines_sse2};
+#endif
+#ifdef SCAN_AVX2
+constexpr Kernels AVX2_KERNELS{Level::AVX2, skip_space_avx2, skip_ident_avx2, find_line_end_avx2, count_newlines_avx2};
+#endif
+
+const Kernels* kernels_for(const Level level) {
+#ifdef SCAN_AVX2
+    if (level == Level::AVX2) return &AVX2_KERNELS;
+#endif
+#ifdef SCAN_SSE2
+    if (level == Level::SSE2) return &SSE2_KERNELS;
+#endif
+    return level == Level::SCALAR ? &SCALAR_KERNELS : nullptr;
+}
+
+std::atomic<const Kernels*> active{nullptr};
+
+const Kernels& kernels() {
+    auto* current = active.load(std::memory_order_relaxed);
+    if (!current) {
+        current = kernels_for(best_level());
+        active.store(current, std::memory_order_relaxed);
+    }
+    return *current;
+}
+
+}
+
+size_t skip_space(const char* data, const size_t pos, const size_t size) {
+    return kernels().skip_space(data, pos, size);
+}
+
+size_t skip_ident(const char* data, const size_t pos, const size_t size) {
+    return kernels().skip_ident(data, pos, size);
+}
+
+size_t find_line_end(const char* data, const size_t pos, const size_t size) {
+    return kernels().find_line_end(data, pos, size);
+}
+
+size_t count_newlines(const char* data, const size_t begin, const size_t end) {
+    return begin < end ? kernels().count_newlines(data, begin, end) : 0;
+}
+
+Level level() {
+    return kernels().level;
+}
+
+Level best_level() {
+#ifdef SCAN_AVX2
+    if (__builtin_cpu_supports("avx2")) return Level::AVX2;
+#endif
+#ifdef SCAN_SSE2
+    return Level::SSE2;
+#else
+    return Level::SCALAR;
+#endif
+}
+
+void set_level(const Level level) {
+    const auto* chosen = level <= best_level() ? kernels_for(level) : nullptr;
+    active.store(chosen ? chosen : kernels_for(best_level()), std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,36 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+
+#include <cstddef>
+
+
+// byte-class scanning for the lexer, 16 (SSE2) or 32 (AVX2) bytes at a time
+// where the CPU allows; the widest supported kernel is picked on first use.
+// Every function looks at [pos, size) only and returns size when it runs out.
+namespace scan {
+
+enum class Level {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+// first byte at or after pos that is not ' ', '\t', '\n', '\v', '\f' or '\r'
+size_t skip_space(const char* data, size_t pos, size_t size);
+// first byte at or after pos that is not [A-Za-z0-9_]
+size_t skip_ident(const char* data, size_t pos, size_t size);
+// first '\n' or NUL at or after pos: where a ';' comment ends
+size_t find_line_end(const char* data, size_t pos, size_t size);
+// '\n' bytes in [begin, end)
+size_t count_newlines(const char* data, size_t begin, size_t end);
+
+// the kernels in use, and the widest this CPU supports
+Level level();
+Level best_level();
+// benchmarks compare the kernels; a level the CPU lacks falls back to the best one
+void set_level(Level level);
+
+}
+
+#endif // SCAN_H
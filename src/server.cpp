@@ -0,0 +1,283 @@
+#include "server.h"
+#include "assembler.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#endif
+
+
+namespace {
+
+constexpr uint32_t MAX_MESSAGE_SIZE = 1u << 30;
+
+long read_some(const int fd, char* buffer, const size_t size) {
+#ifdef _WIN32
+    return _read(fd, buffer, static_cast<unsigned>(size));
+#else
+    return ::read(fd, buffer, size);
+#endif
+}
+
+long write_some(const int fd, const char* buffer, const size_t size) {
+#ifdef _WIN32
+    return _write(fd, buffer, static_cast<unsigned>(size));
+#else
+    return ::write(fd, buffer, size);
+#endif
+}
+
+// false on a clean end of stream before the first byte
+bool read_exact(const int fd, char* buffer, const size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        const auto n = read_some(fd, buffer + done, size - done);
+        if (n <= 0) {
+            if (done == 0) return false;
+            throw std::runtime_error("Truncated message");
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void write_all(const int fd, const char* buffer, const size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        const auto n = write_some(fd, buffer + done, size - done);
+        if (n <= 0) throw std::runtime_error("Failed to write response");
+        done += static_cast<size_t>(n);
+    }
+}
+
+std::optional<std::string> read_message(const int fd) {
+    unsigned char prefix[4];
+    if (!read_exact(fd, reinterpret_cast<char*>(prefix), sizeof(prefix))) return std::nullopt;
+
+    const uint32_t size = (static_cast<uint32_t>(prefix[0]) << 24) | (static_cast<uint32_t>(prefix[1]) << 16) |
+                          (static_cast<uint32_t>(prefix[2]) << 8) | static_cast<uint32_t>(prefix[3]);
+    if (size > MAX_MESSAGE_SIZE) throw std::runtime_error("Message too large");
+
+    std::string message(size, '\0');
+    if (size > 0 && !read_exact(fd, message.data(), size)) throw std::runtime_error("Truncated message");
+    return message;
+}
+
+void write_message(const int fd, const std::string& message) {
+    const auto size = static_cast<uint32_t>(message.size());
+    const char prefix[4] = {
+        static_cast<char>(size >> 24), static_cast<char>(size >> 16),
+        static_cast<char>(size >> 8), static_cast<char>(size)
+    };
+    write_all(fd, prefix, sizeof(prefix));
+    write_all(fd, message.data(), message.size());
+}
+
+bool is_set(const std::string& value) {
+    return value == "1" || value == "yes" || value == "true";
+}
+
+#ifndef _WIN32
+// a client socket shared by its reader and the requests in flight; closed with the last of them
+struct Connection {
+    explicit Connection(const int fd) : fd(fd) {}
+    ~Connection() { ::close(fd); }
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    const int fd;
+    std::mutex output_mutex;
+};
+
+// a socket file left behind by a server that is gone; anything else at the path is kept
+bool is_stale_socket(const std::string& path, const sockaddr_un& addr) {
+    struct stat info{};
+    if (::lstat(path.c_str(), &info) < 0) {
+        if (errno == ENOENT) return false;
+        throw std::runtime_error("Failed to inspect " + path);
+    }
+    if (!S_ISSOCK(info.st_mode)) throw std::runtime_error("Not a socket, refusing to replace: " + path);
+
+    const auto probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0) throw std::runtime_error("Failed to create socket");
+    const auto live = ::connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+    ::close(probe);
+    if (live) throw std::runtime_error("Another server is listening on " + path);
+    return true;
+}
+#endif
+
+}
+
+AssemblerServer::AssemblerServer(const unsigned threads) : pool_(threads) {}
+
+std::string AssemblerServer::handle(const std::string& request) {
+    std::unordered_map<std::string, std::string> headers;
+    const auto body = request.find("\n\n");
+    std::istringstream header_lines(request.substr(0, body));
+    std::string line;
+    while (std::getline(header_lines, line)) {
+        const auto colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        const auto value = line.find_first_not_of(' ', colon + 1);
+        headers[line.substr(0, colon)] = value == std::string::npos ? "" : line.substr(value);
+    }
+    const auto source = body == std::string::npos ? std::string{} : request.substr(body + 2);
+
+    std::ostringstream diagnostics;
+    std::string inst_text;
+    std::string data_text;
+    std::string error;
+
+    try {
+        AssemblerOptions options;
+        options.diagnostics = &diagnostics;
+        options.fragments = &fragments_;
+        if (headers["core"] == "extended") {
+            options.core = TargetCore::EXTENDED;
+        } else if (!headers["core"].empty() && headers["core"] != "classic") {
+            throw std::runtime_error("Unknown core: " + headers["core"]);
+        }
+        options.eliminate_dead_code = is_set(headers["eliminate-dead"]);
+        options.optimize_layout = is_set(headers["layout"]) || !headers["layout-profile"].empty();
+        options.layout_profile_path = headers["layout-profile"];
+
+        if (headers["inst-template"].empty() || headers["data-template"].empty()) {
+            throw std::runtime_error("Request needs inst-template and data-template");
+        }
+        const auto inst_template = templates_.get(headers["inst-template"]);
+        const auto data_template = templates_.get(headers["data-template"]);
+
+        const auto [instructions, data] = Assembler(source, options).encode();
+
+        inst_text = utils::render_template(*inst_template, instructions);
+        data_text = utils::render_template(*data_template, data);
+        if (!headers["inst-output"].empty()) {
+            utils::write_file(headers["inst-output"], inst_text);
+            inst_text.clear();
+        }
+        if (!headers["data-output"].empty()) {
+            utils::write_file(headers["data-output"], data_text);
+            data_text.clear();
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+        for (auto& c : error) {
+            if (c == '\n') c = ' ';
+        }
+        inst_text.clear();
+        data_text.clear();
+    }
+
+    const auto report = diagnostics.str();
+    std::string response;
+    response.reserve(128 + report.size() + inst_text.size() + data_text.size());
+    response += "id: " + headers["id"] + "\n";
+    if (error.empty()) {
+        response += "status: ok\n";
+    } else {
+        response += "status: error\nerror: " + error + "\n";
+    }
+    response += "diagnostics: " + std::to_string(report.size()) + "\n";
+    response += "inst: " + std::to_string(inst_text.size()) + "\n";
+    response += "data: " + std::to_string(data_text.size()) + "\n\n";
+    response += report;
+    response += inst_text;
+    response += data_text;
+    return response;
+}
+
+void AssemblerServer::serve_stdio() {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#else
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+    const auto in = fileno(stdin);
+    const auto out = fileno(stdout);
+
+    // once stdout is gone no response can be delivered, so the next request ends the loop
+    while (!output_failed_) {
+        auto request = read_message(in);
+        if (!request) break;
+        pool_.submit([this, out, request = std::move(*request)] {
+            const auto response = handle(request);
+            std::lock_guard lock(output_mutex_);
+            if (output_failed_) return;
+            try {
+                write_message(out, response);
+            } catch (const std::exception&) {
+                output_failed_ = true;
+            }
+        });
+    }
+    if (output_failed_) throw std::runtime_error("Failed to write response");
+}
+
+void AssemblerServer::serve_connection(const int fd) {
+#ifdef _WIN32
+    (void)fd;
+#else
+    const auto connection = std::make_shared<Connection>(fd);
+    try {
+        while (auto request = read_message(fd)) {
+            pool_.submit([this, connection, request = std::move(*request)] {
+                const auto response = handle(request);
+                std::lock_guard lock(connection->output_mutex);
+                try {
+                    write_message(connection->fd, response);
+                } catch (const std::exception&) {
+                    // the client stopped reading; wake the reader so the connection is dropped
+                    ::shutdown(connection->fd, SHUT_RDWR);
+                }
+            });
+        }
+    } catch (const std::exception&) {
+        // the client went away mid-message; nothing to answer
+    }
+#endif
+}
+
+void AssemblerServer::serve_socket(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+    throw std::runtime_error("Unix sockets are not available on this platform, use --stdio");
+#else
+    std::signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) throw std::runtime_error("Socket path too long: " + path);
+    path.copy(addr.sun_path, path.size());
+
+    const auto listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) throw std::runtime_error("Failed to create socket");
+
+    if (is_stale_socket(path, addr)) ::unlink(path.c_str());
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(listener, 64) < 0) {
+        ::close(listener);
+        throw std::runtime_error("Failed to listen on " + path);
+    }
+
+    while (true) {
+        const auto fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0) continue;
+        // reading waits on the client, so it gets its own thread and the pool only assembles
+        std::thread([this, fd] { serve_connection(fd); }).detach();
+    }
+#endif
+}
@@ -0,0 +1,48 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+
+#include "preprocessor.h"
+#include "template_cache.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+
+// long-lived assembler serving length-prefixed requests.
+//
+// every message is a 4-byte big-endian length followed by that many bytes.
+// a request is "key: value" header lines, an empty line, then the source:
+//   id             echoed back, to match responses to requests
+//   inst-template  data-template          required template paths
+//   inst-output    data-output            write the memory there instead of returning it
+//   core, eliminate-dead, layout, layout-profile   as the command line options
+// a response carries "id", "status: ok" or "status: error" with "error: <message>",
+// then "diagnostics", "inst" and "data" lengths; the empty line is followed by
+// that many bytes of pass reports, rendered instruction and data memory
+class AssemblerServer {
+public:
+    explicit AssemblerServer(unsigned threads = 0);
+
+    // requests on stdin, responses on stdout, until stdin is closed
+    void serve_stdio();
+    // one connection per client on a local Unix socket, until the process is killed;
+    // each client is read on its own thread and its requests are assembled on the pool
+    void serve_socket(const std::string& path);
+
+    // a request payload to its response payload
+    std::string handle(const std::string& request);
+
+private:
+    void serve_connection(int fd);
+
+    TemplateCache templates_;
+    FragmentCache fragments_; // .include files, lexed once per server
+    std::mutex output_mutex_;
+    std::atomic<bool> output_failed_ = false; // stdout closed under serve_stdio
+    ThreadPool pool_; // last, so pending requests finish before the rest is destroyed
+};
+
+#endif // SERVER_H
@@ -0,0 +1,130 @@
+#include "source_map.h"
+#include "cfg.h"
+#include "interner.h"
+#include "mapped_file.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+
+
+namespace {
+
+// far more code than an instruction memory holds; bounds what a corrupt map can allocate
+constexpr uint32_t MAX_TEXT_BYTES = 64u << 20;
+
+// the whitespace-separated fields of line; a count above fields.size() means there were more
+template <size_t N>
+size_t split_fields(const std::string_view line, std::array<std::string_view, N>& fields) {
+    size_t count = 0;
+    for (size_t pos = 0;; ++count) {
+        pos = line.find_first_not_of(" \t\r", pos);
+        if (pos == std::string_view::npos) return count;
+        const auto end = std::min(line.find_first_of(" \t\r", pos), line.size());
+        if (count < N) fields[count] = line.substr(pos, end - pos);
+        pos = end;
+    }
+}
+
+template <typename T>
+bool parse_field(const std::string_view field, T& value, const int base) {
+    const auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), value, base);
+    return error == std::errc{} && end == field.data() + field.size();
+}
+
+}
+
+SourceMap build_source_map(const AST& ast) {
+    SourceMap map;
+    uint32_t label = 0;
+    // the blocks ControlFlowGraph would build, numbered the same way, without
+    // paying for its edges: a label after code or a branch ends a block
+    uint32_t block = 0;
+    auto block_has_code = false;
+    for (const auto& node : ast.nodes) {
+        if (node->section != Section::TEXT) continue;
+        if (node->type == NodeType::LABEL) {
+            map.labels.push_back(dynamic_cast<const LabelNode*>(node.get())->name);
+            label = static_cast<uint32_t>(map.labels.size() - 1);
+            if (block_has_code) {
+                ++block;
+                block_has_code = false;
+            }
+        } else if (node->type == NodeType::INSTRUCTION) {
+            const auto word = node->address / 4;
+            if (word >= map.entries.size()) map.entries.resize(word + 1);
+            map.entries[word] = {node->line, block, label};
+            block_has_code = true;
+            if (is_branch(node.get())) {
+                ++block;
+                block_has_code = false;
+            }
+        }
+    }
+    return map;
+}
+
+void write_source_map(const std::string& path, const SourceMap& map) {
+    std::string out = "; address line block label\n";
+    out.reserve(out.size() + 32 * map.entries.size());
+    char address[16];
+    for (size_t word = 0; word < map.entries.size(); ++word) {
+        const auto& entry = map.entries[word];
+        if (entry.line == 0) continue;
+        std::snprintf(address, sizeof(address), "%zx ", 4 * word);
+        out += address;
+        out += std::to_string(entry.line);
+        out += ' ';
+        out += std::to_string(entry.block);
+        out += ' ';
+        out += map.labels[entry.label];
+        out += '\n';
+    }
+    utils::write_file(path, out);
+}
+
+SourceMap load_source_map(const std::string& path) {
+    std::unique_ptr<MappedFile> file;
+    try {
+        file = std::make_unique<MappedFile>(path);
+    } catch (const std::exception&) {
+        throw std::runtime_error("Failed to open source map: " + path);
+    }
+    const std::string_view text(reinterpret_cast<const char*>(file->data()), file->size());
+
+    SourceMap map;
+    SymbolInterner label_ids;
+    label_ids.intern(map.labels.front());
+    int line_no = 0;
+    for (size_t pos = 0; pos < text.size();) {
+        ++line_no;
+        const auto end = std::min(text.find('\n', pos), text.size());
+        auto line = text.substr(pos, end - pos);
+        pos = end + 1;
+        if (const auto comment = line.find(';'); comment != std::string_view::npos) line = line.substr(0, comment);
+
+        std::array<std::string_view, 4> fields;
+        const auto count = split_fields(line, fields);
+        if (count == 0) continue;
+
+        uint32_t address = 0;
+        SourceMap::Entry entry;
+        if (count != fields.size() || !parse_field(fields[0], address, 16) || !parse_field(fields[1], entry.line, 10) ||
+            !parse_field(fields[2], entry.block, 10) || address % 4 != 0 || address >= MAX_TEXT_BYTES ||
+            entry.line <= 0 || entry.block >= MAX_TEXT_BYTES / 4) {
+            throw std::runtime_error("Malformed source map entry at " + path + ":" + std::to_string(line_no));
+        }
+        entry.label = label_ids.intern(fields[3]);
+        if (entry.label == map.labels.size()) map.labels.emplace_back(fields[3]);
+
+        const auto word = address / 4;
+        if (word >= map.entries.size()) map.entries.resize(word + 1);
+        map.entries[word] = entry;
+    }
+    return map;
+}
@@ -0,0 +1,30 @@
+#ifndef SOURCE_MAP_H
+#define SOURCE_MAP_H
+
+
+#include "parser.h"
+
+#include <string>
+#include <vector>
+
+
+// where every .text word came from, indexed by address / 4
+struct SourceMap {
+    struct Entry {
+        int line = 0;        // 0 for an address no instruction was placed at
+        uint32_t block = 0;  // basic block, numbered in address order
+        uint32_t label = 0;  // index into labels
+    };
+
+    std::vector<Entry> entries;
+    std::vector<std::string> labels{"-"}; // the last label before each instruction; "-" before the first
+};
+
+// from the AST once pass1 assigned the addresses
+SourceMap build_source_map(const AST& ast);
+
+// one "<hex address> <line> <block> <label>" line per instruction; ';' starts a comment
+void write_source_map(const std::string& path, const SourceMap& map);
+SourceMap load_source_map(const std::string& path);
+
+#endif // SOURCE_MAP_H
@@ -0,0 +1,587 @@
+#ifndef STATIC_ASSEMBLER_H
+#define STATIC_ASSEMBLER_H
+
+
+#include "common.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+
+// compile-time counterpart of Assembler, for programs embedded in C++ sources:
+//
+//   constexpr auto program = static_asm::assemble<R"(
+//       .text
+//       halt: beq $r0, $r0, halt
+//   )">();
+//   static_assert(program.text[0] == 0x1108FFFF);
+//
+// the source is lexed, parsed and encoded by the same rules as the runtime passes,
+// from the tables in common.h; virtual registers are rejected, they need the allocator.
+// an assembly error stops the compilation at the check that failed
+namespace static_asm {
+
+template <size_t N>
+struct fixed_string {
+    char chars[N] {};
+
+    consteval fixed_string(const char (&str)[N]) { std::copy_n(str, N, chars); }
+    [[nodiscard]] constexpr std::string_view view() const { return {chars, N - 1}; }
+};
+
+template <size_t TextWords, size_t DataWords>
+struct Program {
+    std::array<uint32_t, TextWords> text;
+    std::array<uint32_t, DataWords> data; // .word values and .space zeroes, then the literal pool
+};
+
+namespace detail {
+
+// not constexpr: reaching it during constant evaluation turns the message into a compile error
+inline void assembly_error(const char* message) {
+    throw std::runtime_error(message);
+}
+
+template <typename Table>
+constexpr std::optional<uint32_t> lookup(const Table& table, const std::string_view name) {
+    for (const auto& [key, value] : table) {
+        if (key == name) return value;
+    }
+    return std::nullopt;
+}
+
+constexpr bool is_extended(const std::string_view mnemonic) {
+    return std::find(std::begin(EXTENDED_MNEMONICS), std::end(EXTENDED_MNEMONICS), mnemonic) !=
+           std::end(EXTENDED_MNEMONICS);
+}
+
+constexpr bool is_space(const char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+constexpr bool is_digit(const char c) { return c >= '0' && c <= '9'; }
+constexpr bool is_alpha(const char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+constexpr bool is_alnum(const char c) { return is_alpha(c) || is_digit(c); }
+constexpr bool is_xdigit(const char c) { return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+
+constexpr int digit_value(const char c) {
+    if (is_digit(c)) return c - '0';
+    return (c >= 'a' ? c - 'a' : c - 'A') + 10;
+}
+
+// std::stoll(text, nullptr, 0): a sign, then 0x hex, 0 octal or decimal up to the first other character
+constexpr std::optional<int64_t> parse_number(std::string_view text) {
+    const auto negative = !text.empty() && text[0] == '-';
+    if (negative) text.remove_prefix(1);
+
+    int base = 10;
+    if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X') && is_xdigit(text[2])) {
+        base = 16;
+        text.remove_prefix(2);
+    } else if (!text.empty() && text[0] == '0') {
+        base = 8;
+    }
+
+    int64_t value = 0;
+    size_t digits = 0;
+    for (const auto c : text) {
+        if (!(base == 16 ? is_xdigit(c) : is_digit(c) && digit_value(c) < base)) break;
+        if (value > (INT64_MAX - digit_value(c)) / base) return std::nullopt; // std::out_of_range
+        value = value * base + digit_value(c);
+        ++digits;
+    }
+    if (digits == 0) return std::nullopt;
+    return negative ? -value : value;
+}
+
+struct Token {
+    TokenType type;
+    std::string_view text;
+};
+
+// Lexer::next_token over the whole source
+constexpr std::vector<Token> lex(const std::string_view src, const TargetCore core) {
+    std::vector<Token> tokens;
+    size_t pos = 0;
+    auto at = [&](const size_t i) { return i < src.size() ? src[i] : '\0'; };
+    auto read_ident = [&] {
+        while (at(pos) == '_' || is_alnum(at(pos))) ++pos;
+    };
+
+    while (true) {
+        while (is_space(at(pos))) ++pos;
+        if (at(pos) == ';') {
+            while (at(pos) != '\0' && at(pos) != '\n') ++pos;
+            continue;
+        }
+        if (at(pos) == '\0') {
+            tokens.push_back({TokenType::EoF, {}});
+            return tokens;
+        }
+
+        const auto start = pos;
+        const auto c = at(pos);
+        if (is_alpha(c) || c == '_') {
+            read_ident();
+            const auto ident = src.substr(start, pos - start);
+            // the classic core has no extended mnemonics, they are plain identifiers there
+            const auto inst = (lookup(FUNCT_TABLE, ident) || lookup(OPCODE_TABLE, ident)) &&
+                              (core == TargetCore::EXTENDED || !is_extended(ident));
+            tokens.push_back({inst ? TokenType::INST : TokenType::IDENT, ident});
+        } else if (is_digit(c) || c == '-') {
+            if (c == '-') ++pos;
+            if (at(pos) == '0' && (at(pos + 1) == 'x' || at(pos + 1) == 'X')) {
+                pos += 2;
+                while (is_xdigit(at(pos))) ++pos;
+            } else {
+                while (is_digit(at(pos))) ++pos;
+            }
+            tokens.push_back({TokenType::NUMBER, src.substr(start, pos - start)});
+        } else if (c == '$') {
+            ++pos;
+            read_ident();
+            const auto reg = src.substr(start + 1, pos - start - 1);
+            const auto valid = lookup(REGISTER_TABLE, reg) || is_virtual_register(reg);
+            tokens.push_back({valid ? TokenType::REGISTER : TokenType::ILLEGAL, src.substr(start, pos - start)});
+        } else if (c == '"') {
+            ++pos;
+            while (at(pos) != '"' && at(pos) != '\n' && at(pos) != '\0') ++pos;
+            if (at(pos) != '"') {
+                tokens.push_back({TokenType::ILLEGAL, src.substr(start, pos - start)});
+            } else {
+                tokens.push_back({TokenType::STRING, src.substr(start + 1, pos - start - 1)});
+                ++pos;
+            }
+        } else {
+            ++pos;
+            auto type = TokenType::ILLEGAL;
+            switch (c) {
+                case '.': type = TokenType::DOT; break;
+                case ',': type = TokenType::COMMA; break;
+                case ':': type = TokenType::COLON; break;
+                case '=': type = TokenType::EQUALS; break;
+                case '(': type = TokenType::LPAREN; break;
+                case ')': type = TokenType::RPAREN; break;
+                default: break;
+            }
+            tokens.push_back({type, src.substr(start, 1)});
+        }
+    }
+}
+
+enum class Kind { LABEL, DIRECTIVE, RTYPE, ITYPE, JTYPE };
+
+// the AST node types of parser.h folded into one value type
+struct Statement {
+    Kind kind = Kind::LABEL;
+    std::string_view name;     // label, directive or mnemonic
+    std::string_view rd;       // registers without '$'; rt may hold a shift amount
+    std::string_view rs;
+    std::string_view rt;
+    std::string_view operand;  // immediate, label, jump target or literal value
+    bool is_label_ref = false;
+    bool is_literal = false;
+    std::vector<std::string_view> values; // .word values, .globl names
+    uint32_t size = 0;         // bytes of .space
+    uint32_t address = 0;
+    Section section = Section::TEXT;
+    size_t pool_index = 0;     // literal loads
+};
+
+// Parser::parse, without its recovery: a program the runtime parser rejects fails here too
+class Parser {
+public:
+    constexpr explicit Parser(const std::vector<Token>& tokens) : tokens_(tokens) {}
+
+    constexpr std::vector<Statement> parse() {
+        std::vector<Statement> statements;
+        while (current().type != TokenType::EoF) {
+            if (current().type == TokenType::ILLEGAL) {
+                advance();
+            } else {
+                statements.push_back(parse_statement());
+            }
+        }
+        return statements;
+    }
+
+private:
+    [[nodiscard]] constexpr const Token& current() const { return tokens_[pos_]; }
+    [[nodiscard]] constexpr const Token& peek() const { return tokens_[std::min(pos_ + 1, tokens_.size() - 1)]; }
+
+    constexpr std::string_view advance() {
+        const auto text = current().text;
+        if (pos_ + 1 < tokens_.size()) ++pos_;
+        return text;
+    }
+
+    constexpr void expect(const TokenType type, const char* message) const {
+        if (current().type != type) assembly_error(message);
+    }
+
+    constexpr std::string_view expect_register(const char* message) {
+        expect(TokenType::REGISTER, message);
+        const auto reg = advance().substr(1);
+        if (is_virtual_register(reg)) assembly_error("Virtual registers need the runtime register allocator");
+        return reg;
+    }
+
+    constexpr void expect_comma(const char* message) {
+        expect(TokenType::COMMA, message);
+        advance();
+    }
+
+    constexpr std::string_view expect_number_or_label(Statement& stmt, const char* message) {
+        if (current().type != TokenType::NUMBER && current().type != TokenType::IDENT) assembly_error(message);
+        stmt.is_label_ref = current().type == TokenType::IDENT;
+        return advance();
+    }
+
+    constexpr void parse_base(Statement& stmt) {
+        if (current().type == TokenType::LPAREN) {
+            advance();
+            stmt.rs = expect_register("Expected source register in parentheses");
+            expect(TokenType::RPAREN, "Expected closing parenthesis");
+            advance();
+        }
+    }
+
+    constexpr Statement parse_statement() {
+        Statement stmt;
+
+        if (current().type == TokenType::DOT) {
+            advance();
+            expect(TokenType::IDENT, "Expected directive name after '.'");
+            stmt.kind = Kind::DIRECTIVE;
+            stmt.name = advance();
+            if (stmt.name == "global") stmt.name = "globl";
+            if (current().type == TokenType::COLON) advance();
+            if (stmt.name == "space") {
+                expect(TokenType::NUMBER, "Expected byte count after .space");
+                const auto bytes = parse_number(advance());
+                if (!bytes || *bytes < 0 || *bytes > 0x7FFFFFFC) assembly_error("Invalid .space size");
+                stmt.size = static_cast<uint32_t>((*bytes + 3) & ~int64_t{3});
+            } else if (stmt.name == "incbin") {
+                // the file is only there at run time
+                assembly_error(".incbin needs the runtime assembler");
+            }
+            if (stmt.name == "word" || stmt.name == "globl") {
+                while ((current().type == TokenType::NUMBER && stmt.name == "word") ||
+                       current().type == TokenType::IDENT) {
+                    stmt.values.push_back(advance());
+                    if (current().type != TokenType::COMMA) break;
+                    advance();
+                }
+            }
+            return stmt;
+        }
+
+        if (current().type == TokenType::IDENT && peek().type == TokenType::COLON) {
+            stmt.name = advance();
+            advance();
+            return stmt;
+        }
+
+        if (current().type == TokenType::IDENT && is_extended(current().text)) {
+            assembly_error("Instruction not supported by the classic core");
+        }
+        if (current().type != TokenType::INST) assembly_error("Unexpected token in statement");
+        stmt.name = advance();
+
+        if (lookup(FUNCT_TABLE, stmt.name)) {
+            stmt.kind = Kind::RTYPE;
+            stmt.rd = expect_register("Expected destination register for R-type instruction");
+            expect_comma("Expected comma after destination register");
+            stmt.rs = expect_register("Expected first source register");
+            expect_comma("Expected comma after first source register");
+            if ((stmt.name == "sll" || stmt.name == "srl") && current().type == TokenType::NUMBER) {
+                stmt.rt = advance();
+            } else {
+                stmt.rt = expect_register("Expected second source register or shift amount");
+            }
+        } else if (stmt.name == "j" || stmt.name == "jal") {
+            stmt.kind = Kind::JTYPE;
+            stmt.operand = expect_number_or_label(stmt, "Expected jump target");
+        } else if (stmt.name == "beq" || stmt.name == "bne") {
+            stmt.kind = Kind::ITYPE;
+            stmt.rs = expect_register("Expected first register for branch");
+            expect_comma("Expected comma after first register");
+            stmt.rt = expect_register("Expected second register for branch");
+            expect_comma("Expected comma after second register");
+            expect(TokenType::IDENT, "Expected label name for branch");
+            stmt.operand = advance();
+            stmt.is_label_ref = true;
+        } else if (stmt.name == "lw" || stmt.name == "sw") {
+            stmt.kind = Kind::ITYPE;
+            stmt.rt = expect_register("Expected target register for lw/sw");
+            expect_comma("Expected comma after target register");
+            if (current().type == TokenType::EQUALS) {
+                if (stmt.name != "lw") assembly_error("Literal operand is only allowed for lw");
+                advance();
+                if (current().type != TokenType::NUMBER && current().type != TokenType::IDENT) {
+                    assembly_error("Expected constant or label after '='");
+                }
+                stmt.operand = advance();
+                stmt.is_label_ref = true;
+                stmt.is_literal = true;
+            } else {
+                if (current().type != TokenType::IDENT) expect(TokenType::NUMBER, "Expected immediate value or label");
+                stmt.is_label_ref = current().type == TokenType::IDENT;
+                stmt.operand = advance();
+                parse_base(stmt);
+            }
+        } else {
+            // addi/slti/andi/ori rt, rs, imm
+            stmt.kind = Kind::ITYPE;
+            stmt.rt = expect_register("Expected target register");
+            expect_comma("Expected comma after target register");
+            stmt.rs = expect_register("Expected source register");
+            expect_comma("Expected comma after source register");
+            stmt.operand = expect_number_or_label(stmt, "Expected immediate value or label");
+        }
+        return stmt;
+    }
+
+    const std::vector<Token>& tokens_;
+    size_t pos_ = 0;
+};
+
+struct Symbol {
+    std::string_view name;
+    uint32_t address;
+};
+
+struct PoolEntry {
+    std::optional<uint32_t> value; // a number, or
+    std::string_view label;        // the label whose address is stored
+};
+
+struct Encoded {
+    std::vector<uint32_t> text;
+    std::vector<uint32_t> data;
+};
+
+// CodeGenerator::pass1 and pass2
+class CodeGenerator {
+public:
+    constexpr explicit CodeGenerator(const TargetCore core) : core_(core) {}
+
+    constexpr Encoded encode(std::vector<Statement>& statements) {
+        pass1(statements);
+
+        Encoded out;
+        for (const auto& stmt : statements) {
+            if (stmt.kind == Kind::RTYPE) {
+                out.text.push_back(encode_r(stmt));
+            } else if (stmt.kind == Kind::ITYPE) {
+                out.text.push_back(encode_i(stmt));
+            } else if (stmt.kind == Kind::JTYPE) {
+                out.text.push_back(encode_j(stmt));
+            } else if (stmt.kind == Kind::DIRECTIVE && stmt.name == "word") {
+                for (const auto value : stmt.values) out.data.push_back(encode_word(value));
+            } else if (stmt.kind == Kind::DIRECTIVE && stmt.name == "space") {
+                out.data.resize(out.data.size() + stmt.size / 4);
+            }
+        }
+        for (const auto& entry : pool_) {
+            if (entry.value) {
+                out.data.push_back(*entry.value);
+            } else if (const auto label_addr = address_of(entry.label)) {
+                out.data.push_back(*label_addr);
+            } else {
+                assembly_error("Unresolved label in literal");
+            }
+        }
+        return out;
+    }
+
+private:
+    constexpr void pass1(std::vector<Statement>& statements) {
+        uint32_t text_addr = 0;
+        uint32_t data_addr = 0;
+        auto section = Section::TEXT;
+
+        for (auto& stmt : statements) {
+            stmt.section = section;
+            stmt.address = section == Section::DATA ? data_addr : text_addr;
+
+            if (stmt.kind == Kind::LABEL) {
+                for (const auto& symbol : symbols_) {
+                    if (symbol.name == stmt.name) assembly_error("Duplicate label");
+                }
+                symbols_.push_back({stmt.name, stmt.address});
+            } else if (stmt.kind == Kind::DIRECTIVE) {
+                if (stmt.name == "text") {
+                    section = Section::TEXT;
+                } else if (stmt.name == "data") {
+                    section = Section::DATA;
+                } else if (stmt.name == "word") {
+                    if (section == Section::TEXT) assembly_error(".word directive not allowed in .text section");
+                    data_addr += 4 * static_cast<uint32_t>(stmt.values.size());
+                } else if (stmt.name == "space") {
+                    if (section == Section::TEXT) assembly_error(".space directive not allowed in .text section");
+                    data_addr += stmt.size;
+                }
+            } else {
+                if (section == Section::DATA) assembly_error("Instructions not allowed in .data section");
+                if (core_ == TargetCore::CLASSIC && is_extended(stmt.name)) {
+                    assembly_error("Instruction not supported by the classic core");
+                }
+                if (stmt.is_literal) stmt.pool_index = pool_entry(stmt.operand);
+                text_addr += 4;
+            }
+        }
+
+        // the literal pool goes after all the data
+        pool_address_ = data_addr;
+    }
+
+    // constants are keyed by value, so 16 and 0x10 share an entry
+    constexpr size_t pool_entry(const std::string_view operand) {
+        PoolEntry entry;
+        if (is_digit(operand[0]) || operand[0] == '-') {
+            const auto value = parse_number(operand);
+            if (!value) assembly_error("Invalid number in literal");
+            entry.value = static_cast<uint32_t>(*value);
+        } else {
+            entry.label = operand;
+        }
+        for (size_t idx = 0; idx < pool_.size(); ++idx) {
+            if (pool_[idx].value == entry.value && pool_[idx].label == entry.label) return idx;
+        }
+        pool_.push_back(entry);
+        return pool_.size() - 1;
+    }
+
+    [[nodiscard]] constexpr std::optional<uint32_t> address_of(const std::string_view name) const {
+        for (const auto& symbol : symbols_) {
+            if (symbol.name == name) return symbol.address;
+        }
+        return std::nullopt;
+    }
+
+    static constexpr uint32_t reg_num(const std::string_view reg) {
+        const auto num = lookup(REGISTER_TABLE, reg);
+        if (!num) assembly_error("Invalid register");
+        return *num;
+    }
+
+    constexpr uint32_t encode_r(const Statement& stmt) const {
+        uint32_t rs_num = reg_num(stmt.rs);
+        uint32_t rt_num = 0;
+        uint32_t shamt = 0;
+
+        if ((stmt.name == "sll" || stmt.name == "srl") && !lookup(REGISTER_TABLE, stmt.rt)) {
+            const auto shift_amt = parse_number(stmt.rt);
+            if (!shift_amt || *shift_amt < 0 || *shift_amt > 31) assembly_error("Shift amount must be between 0 and 31");
+            shamt = static_cast<uint32_t>(*shift_amt);
+            rt_num = rs_num;
+            rs_num = 0;
+        } else if (stmt.name == "sll" || stmt.name == "srl") {
+            // sll rd, rs(value), rt(amount) --> rs=rt(amount), rt=rs(value)
+            rt_num = rs_num;
+            rs_num = reg_num(stmt.rt);
+        } else {
+            rt_num = reg_num(stmt.rt);
+        }
+
+        return (rs_num << 21) | (rt_num << 16) | (reg_num(stmt.rd) << 11) | (shamt << 6) |
+               *lookup(FUNCT_TABLE, stmt.name);
+    }
+
+    constexpr uint32_t encode_i(const Statement& stmt) const {
+        const auto rs_num = stmt.rs.empty() ? 0 : reg_num(stmt.rs);
+        const auto rt_num = reg_num(stmt.rt);
+        int32_t imm = 0;
+
+        if (stmt.is_literal) {
+            imm = static_cast<int32_t>(pool_address_ + 4 * static_cast<uint32_t>(stmt.pool_index));
+        } else if (stmt.is_label_ref) {
+            const auto label_addr = address_of(stmt.operand);
+            if (!label_addr) assembly_error("Unresolved label");
+            if (stmt.name == "beq" || stmt.name == "bne") {
+                imm = (static_cast<int32_t>(*label_addr) - static_cast<int32_t>(stmt.address + 4)) / 4;
+            } else {
+                imm = static_cast<int32_t>(*label_addr);
+            }
+        } else {
+            const auto value = parse_number(stmt.operand);
+            if (!value) assembly_error("Invalid immediate");
+            imm = static_cast<int32_t>(*value);
+        }
+
+        // andi/ori zero-extend their immediate, the rest sign-extend it
+        if (stmt.name == "andi" || stmt.name == "ori") {
+            if (imm < 0 || imm > 65535) assembly_error("Immediate overflow");
+        } else if (imm < -32768 || imm > 32767) {
+            assembly_error("Immediate overflow");
+        }
+
+        return (*lookup(OPCODE_TABLE, stmt.name) << 26) | (rs_num << 21) | (rt_num << 16) |
+               (static_cast<uint32_t>(imm) & 0xFFFF);
+    }
+
+    constexpr uint32_t encode_j(const Statement& stmt) const {
+        uint32_t target = 0;
+        if (stmt.is_label_ref) {
+            const auto label_addr = address_of(stmt.operand);
+            if (!label_addr) assembly_error("Unresolved label");
+            target = *label_addr;
+        } else {
+            const auto value = parse_number(stmt.operand);
+            if (!value) assembly_error("Invalid jump target");
+            target = static_cast<uint32_t>(*value);
+        }
+
+        // the 26-bit field holds a word index inside the 256 MB region of the next instruction
+        if (target % 4 != 0) assembly_error("Unaligned jump target");
+        if ((target & 0xF0000000) != ((stmt.address + 4) & 0xF0000000)) assembly_error("Jump target out of range");
+
+        return (*lookup(OPCODE_TABLE, stmt.name) << 26) | ((target >> 2) & 0x3FFFFFF);
+    }
+
+    constexpr uint32_t encode_word(const std::string_view value) const {
+        if (const auto number = parse_number(value); number && (is_digit(value[0]) || value[0] == '-')) {
+            return static_cast<uint32_t>(*number);
+        }
+        const auto label_addr = address_of(value);
+        if (!label_addr) assembly_error("Unresolved label in .word");
+        return *label_addr;
+    }
+
+    TargetCore core_;
+    std::vector<Symbol> symbols_;
+    std::vector<PoolEntry> pool_;
+    uint32_t pool_address_ = 0;
+};
+
+constexpr Encoded encode(const std::string_view source, const TargetCore core) {
+    const auto tokens = lex(source, core);
+    auto statements = Parser(tokens).parse();
+    return CodeGenerator(core).encode(statements);
+}
+
+}
+
+template <fixed_string Source, TargetCore Core = TargetCore::CLASSIC>
+consteval auto assemble() {
+    constexpr auto sizes = [] {
+        const auto encoded = detail::encode(Source.view(), Core);
+        return std::array{encoded.text.size(), encoded.data.size()};
+    }();
+
+    Program<sizes[0], sizes[1]> program{};
+    const auto encoded = detail::encode(Source.view(), Core);
+    std::copy(encoded.text.begin(), encoded.text.end(), program.text.begin());
+    std::copy(encoded.data.begin(), encoded.data.end(), program.data.begin());
+    return program;
+}
+
+}
+
+#endif // STATIC_ASSEMBLER_H
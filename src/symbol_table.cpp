@@ -1,21 +1,29 @@
 #include "symbol_table.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 
-void SymbolTable::add(const std::string& name, uint32_t addr) {
-    if (symbols_.contains(name)) {
-        throw std::runtime_error("Duplicate label: " + name);
+SymbolTable::SymbolTable(std::shared_ptr<SymbolInterner> names) : names_(std::move(names)) {}
+
+void SymbolTable::add(const uint32_t id, const uint32_t addr, const Section section) {
+    if (id >= symbols_.size()) symbols_.resize(std::max<size_t>(id + 1, names_->size()));
+    if (symbols_[id].section != Section::NONE) {
+        throw std::runtime_error("Duplicate label: " + std::string(names_->name(id)));
     }
-    symbols_[name] = addr;
+    symbols_[id] = {addr, section};
+}
+
+void SymbolTable::add(const std::string_view name, const uint32_t addr, const Section section) {
+    add(names_->intern(name), addr, section);
 }
 
-std::optional<uint32_t> SymbolTable::get(const std::string& name) const {
-    auto it = symbols_.find(name);
-    if (it != symbols_.end()) return it->second;
-    return std::nullopt;
+std::optional<Section> SymbolTable::section(const std::string_view name) const {
+    const auto id = names_->find(name);
+    if (!get(id)) return std::nullopt;
+    return symbols_[id].section;
 }
 
-bool SymbolTable::exists(const std::string& name) const {
-    return symbols_.contains(name);
-}
\ No newline at end of file
+bool SymbolTable::exists(const std::string_view name) const {
+    return get(name).has_value();
+}
@@ -3,18 +3,43 @@
 
 
 #include "common.h"
+#include "interner.h"
 
-#include <unordered_map>
+#include <memory>
+#include <string_view>
+#include <vector>
 
 
+// label addresses in a flat array indexed by interned ID; the name overloads
+// go through the interner's lookup first
 class SymbolTable {
 public:
-    void add(const std::string& name, uint32_t addr);
-    std::optional<uint32_t> get(const std::string& name) const;
-    bool exists(const std::string& name) const;
+    explicit SymbolTable(std::shared_ptr<SymbolInterner> names = std::make_shared<SymbolInterner>());
+
+    void add(uint32_t id, uint32_t addr, Section section = Section::TEXT);
+    void add(std::string_view name, uint32_t addr, Section section = Section::TEXT);
+
+    [[nodiscard]] std::optional<uint32_t> get(const uint32_t id) const {
+        if (id >= symbols_.size() || symbols_[id].section == Section::NONE) return std::nullopt;
+        return symbols_[id].addr;
+    }
+    [[nodiscard]] std::optional<uint32_t> get(const std::string_view name) const { return get(names_->find(name)); }
+    // by ID where the node carries one, by name otherwise
+    [[nodiscard]] std::optional<uint32_t> get(const uint32_t id, const std::string_view name) const {
+        return id != NO_SYMBOL ? get(id) : get(name);
+    }
+
+    [[nodiscard]] std::optional<Section> section(std::string_view name) const;
+    [[nodiscard]] bool exists(std::string_view name) const;
 
 private:
-    std::unordered_map<std::string, uint32_t> symbols_;
+    struct Symbol {
+        uint32_t addr = 0;
+        Section section = Section::NONE; // NONE while undefined
+    };
+
+    std::shared_ptr<SymbolInterner> names_;
+    std::vector<Symbol> symbols_; // by ID
 };
 
-#endif // SYMBOL_TABLE_H
\ No newline at end of file
+#endif // SYMBOL_TABLE_H
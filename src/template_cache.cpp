@@ -0,0 +1,22 @@
+#include "template_cache.h"
+#include "common.h"
+
+
+std::shared_ptr<const utils::MemoryTemplate> TemplateCache::get(const std::string& path) {
+    std::error_code ec;
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) throw std::runtime_error("Failed to open template file: " + path);
+
+    {
+        std::lock_guard lock(mutex_);
+        const auto it = entries_.find(path);
+        if (it != entries_.end() && it->second.mtime == mtime) return it->second.tmpl;
+    }
+
+    // parse outside the lock; concurrent misses on the same path just race to store
+    auto tmpl = std::make_shared<const utils::MemoryTemplate>(utils::load_template(path, std::string(subs_token)));
+
+    std::lock_guard lock(mutex_);
+    entries_[path] = {mtime, tmpl};
+    return tmpl;
+}
@@ -0,0 +1,29 @@
+#ifndef TEMPLATE_CACHE_H
+#define TEMPLATE_CACHE_H
+
+
+#include "utils.h"
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+
+// parsed memory templates shared between requests; an entry is reloaded when
+// the file's modification time changes
+class TemplateCache {
+public:
+    std::shared_ptr<const utils::MemoryTemplate> get(const std::string& path);
+
+private:
+    struct Entry {
+        std::filesystem::file_time_type mtime;
+        std::shared_ptr<const utils::MemoryTemplate> tmpl;
+    };
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+#endif // TEMPLATE_CACHE_H
@@ -5,67 +5,120 @@
 #include <bitset>
 #include <cstdint>
 #include <fstream>
+#include <ios>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
 
 namespace utils {
 
-inline void replace_marker_with_output(
-    const std::string& template_file_path,
-    const std::string& output_file_path,
-    const std::string& subs_token,
-    const std::vector<uint8_t>& data
-) {
+// puts back the flags, precision and fill of a stream when it goes out of scope,
+// so a printer can use std::fixed and friends without leaking them to its caller
+class StreamFormatGuard {
+public:
+    explicit StreamFormatGuard(std::ios& stream)
+        : stream_(stream), flags_(stream.flags()), precision_(stream.precision()), fill_(stream.fill()) {}
+    ~StreamFormatGuard() {
+        stream_.flags(flags_);
+        stream_.precision(precision_);
+        stream_.fill(fill_);
+    }
+
+    StreamFormatGuard(const StreamFormatGuard&) = delete;
+    StreamFormatGuard& operator=(const StreamFormatGuard&) = delete;
+
+private:
+    std::ios& stream_;
+    std::ios::fmtflags flags_;
+    std::streamsize precision_;
+    char fill_;
+};
+
+// a memory template split at the marker line that receives the memory contents
+struct MemoryTemplate {
+    std::vector<std::string> lines;
+    size_t marker = 0;
+};
+
+inline MemoryTemplate load_template(const std::string& template_file_path, const std::string& subs_token) {
     std::ifstream in(template_file_path);
     if (!in) throw std::runtime_error("Failed to open template file: " + template_file_path);
 
-    std::vector<std::string> lines;
+    MemoryTemplate tmpl;
     std::string line;
 
     while (std::getline(in, line)) {
-        lines.push_back(line);
+        tmpl.lines.push_back(line);
     }
     in.close();
 
-    std::vector<std::string> data_lines;
-    data_lines.reserve(data.size() / 4);
-
-    for (size_t i = 0, index = 0; i < data.size(); i += 4, ++index) {
-        uint32_t word =
-            (static_cast<uint32_t>(data[i])   << 24) |
-            (static_cast<uint32_t>(data[i + 1]) << 16) |
-            (static_cast<uint32_t>(data[i + 2]) <<  8) |
-             static_cast<uint32_t>(data[i + 3]);
-        data_lines.push_back(
-            std::to_string(index) + " => \"" +
-            std::bitset<32>(word).to_string() + "\","
-        );
-    }
-    data_lines.emplace_back("others => (others => '0')\n");
-
-    auto replaced = false;
-    for (size_t idx = 0; idx < lines.size(); ++idx) {
-        if (lines[idx].find(subs_token) != std::string::npos) {
-            replaced = true;
-            lines.erase(lines.begin() + idx);
-            lines.insert(lines.begin() + idx, data_lines.begin(), data_lines.end());
-            break;
+    for (size_t idx = 0; idx < tmpl.lines.size(); ++idx) {
+        if (tmpl.lines[idx].find(subs_token) != std::string::npos) {
+            tmpl.marker = idx;
+            return tmpl;
         }
     }
 
-    if (!replaced)
-        throw std::runtime_error("No line starting with specified token found in file " + template_file_path);
+    throw std::runtime_error("No line starting with specified token found in file " + template_file_path);
+}
 
-    std::ofstream out(output_file_path, std::ios::trunc);
-    if (!out) throw std::runtime_error("Failed to write to file: " + output_file_path);
+// the big-endian word at bytes
+inline uint32_t read_uint32(const uint8_t* bytes) {
+    return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) |
+           (static_cast<uint32_t>(bytes[2]) << 8) | static_cast<uint32_t>(bytes[3]);
+}
+
+// value as a big-endian word at bytes
+inline void write_uint32(uint8_t* bytes, const uint32_t value) {
+    bytes[0] = (value >> 24) & 0xFF;
+    bytes[1] = (value >> 16) & 0xFF;
+    bytes[2] = (value >> 8) & 0xFF;
+    bytes[3] = value & 0xFF;
+}
+
+// the template lines [begin, end)
+inline void append_lines(std::string& out, const MemoryTemplate& tmpl, const size_t begin, const size_t end) {
+    for (size_t idx = begin; idx < end; ++idx) {
+        out += tmpl.lines[idx];
+        out += '\n';
+    }
+}
 
-    for (const auto& l : lines) {
-        out << l << '\n';
+// one "index => \"bits\"," line per big-endian word, numbered from first_index
+inline void append_words(std::string& out, const uint8_t* bytes, const size_t size, size_t first_index) {
+    for (size_t i = 0; i + 3 < size; i += 4, ++first_index) {
+        const auto word = read_uint32(bytes + i);
+        out += std::to_string(first_index);
+        out += " => \"";
+        out += std::bitset<32>(word).to_string();
+        out += "\",\n";
     }
 }
 
+// what follows the last word: the default value, then the template after the marker
+inline void append_trailer(std::string& out, const MemoryTemplate& tmpl) {
+    out += "others => (others => '0')\n\n";
+    append_lines(out, tmpl, tmpl.marker + 1, tmpl.lines.size());
+}
+
+inline std::string render_template(const MemoryTemplate& tmpl, const std::vector<uint8_t>& data) {
+    std::string out;
+    out.reserve(data.size() / 4 * 48 + 4096);
+
+    append_lines(out, tmpl, 0, tmpl.marker);
+    append_words(out, data.data(), data.size(), 0);
+    append_trailer(out, tmpl);
+    return out;
+}
+
+inline void write_file(const std::string& output_file_path, const std::string& contents) {
+    std::ofstream out(output_file_path, std::ios::trunc);
+    if (!out) throw std::runtime_error("Failed to write to file: " + output_file_path);
+    out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+}
+
 }
 
 
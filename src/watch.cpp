@@ -0,0 +1,407 @@
+#include "watch.h"
+#include "template_cache.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <thread>
+
+
+namespace {
+
+std::vector<std::string_view> split_lines(const std::string_view text) {
+    std::vector<std::string_view> lines;
+    size_t start = 0;
+    while (true) {
+        const auto end = text.find('\n', start);
+        if (end == std::string_view::npos) {
+            lines.push_back(text.substr(start));
+            return lines;
+        }
+        lines.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+}
+
+// the register allocator rewrites the whole program, so such sources are always rebuilt
+bool mentions_virtual_register(const std::string_view text) {
+    for (auto pos = text.find("$v"); pos != std::string_view::npos; pos = text.find("$v", pos + 2)) {
+        if (pos + 2 < text.size() && std::isdigit(static_cast<unsigned char>(text[pos + 2]))) return true;
+    }
+    return false;
+}
+
+// a .word without values swallows whatever identifier or number follows it,
+// so the statements around it cannot be parsed on their own
+bool is_open_word(const Node* node) {
+    const auto* dir = dynamic_cast<const DirectiveNode*>(node);
+    return dir && dir->name == "word" && dir->values.empty();
+}
+
+// the file may change on disk without the source changing, so such programs are always rebuilt
+bool mentions_incbin(const std::string_view text) {
+    return text.find(".incbin") != std::string_view::npos;
+}
+
+bool is_literal_load(const Node* node) {
+    const auto* i_inst = dynamic_cast<const ITypeInst*>(node);
+    return i_inst && i_inst->is_literal;
+}
+
+// true when the replacement occupies exactly the same addresses and defines the same labels
+bool same_layout(const Node* before, const Node* after) {
+    if (before->type != after->type) return false;
+    if (before->type == NodeType::LABEL) {
+        return static_cast<const LabelNode*>(before)->name == static_cast<const LabelNode*>(after)->name;
+    }
+    if (before->type == NodeType::DIRECTIVE) {
+        const auto* old_dir = static_cast<const DirectiveNode*>(before);
+        const auto* new_dir = static_cast<const DirectiveNode*>(after);
+        return old_dir->name == new_dir->name && old_dir->values.size() == new_dir->values.size() && old_dir->size == new_dir->size;
+    }
+    // a literal load may add or drop a pool entry
+    return !is_literal_load(before) && !is_literal_load(after);
+}
+
+const std::string* referenced_symbol(const Node* node) {
+    if (const auto* i_inst = dynamic_cast<const ITypeInst*>(node); i_inst && i_inst->is_label_ref) {
+        return &i_inst->imm_or_label;
+    }
+    if (const auto* j_inst = dynamic_cast<const JTypeInst*>(node); j_inst && j_inst->is_label_ref) {
+        return &j_inst->target;
+    }
+    return nullptr;
+}
+
+bool is_relative_branch(const Node* node) {
+    const auto* i_inst = dynamic_cast<const ITypeInst*>(node);
+    return i_inst && (i_inst->mnemonic == "beq" || i_inst->mnemonic == "bne");
+}
+
+std::optional<std::filesystem::file_time_type> modification_time(const std::string& path) {
+    std::error_code ec;
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) return std::nullopt;
+    return mtime;
+}
+
+}
+
+IncrementalAssembler::IncrementalAssembler(AssemblerOptions options)
+    : options_(std::move(options)), code_gen_(options_.core) {}
+
+WatchUpdate IncrementalAssembler::update(std::string source) {
+    if (valid_) {
+        try {
+            WatchUpdate result;
+            if (patch(source, result)) {
+                source_ = std::move(source);
+                return result;
+            }
+        } catch (const std::exception&) {
+            // the full pipeline reports the error with the right context, if there still is one
+        }
+    }
+    source_ = std::move(source);
+    return rebuild();
+}
+
+WatchUpdate IncrementalAssembler::rebuild() {
+    valid_ = false;
+
+    WatchUpdate result;
+    result.full = true;
+    result.relaid = true;
+    included_files_.clear();
+    auto options = options_;
+    options.included_files = &included_files_;
+    ast_ = Assembler(source_, options).build_ast();
+    // the binaries are polled along with the included sources
+    for (const auto& node : ast_.nodes) {
+        const auto* dir = dynamic_cast<const DirectiveNode*>(node.get());
+        if (!dir || dir->name != "incbin") continue;
+        if (std::ranges::find(included_files_, dir->values.front()) == included_files_.end()) {
+            included_files_.push_back(dir->values.front());
+        }
+    }
+    symbols_ = code_gen_.pass1(ast_);
+    auto output = code_gen_.pass2(ast_, symbols_);
+
+    result.lines_relexed = std::count(source_.begin(), source_.end(), '\n') + 1;
+    result.words_encoded = (output.instructions.size() + output.data.size()) / 4;
+    result.instructions_changed = output.instructions != output_.instructions;
+    result.data_changed = output.data != output_.data;
+    output_ = std::move(output);
+
+    has_virtual_registers_ = mentions_virtual_register(source_);
+    // an edit may change what a macro or included file expands to anywhere
+    preprocessed_ = uses_preprocessor(source_);
+    binary_included_ = mentions_incbin(source_);
+    valid_ = true;
+    return result;
+}
+
+bool IncrementalAssembler::patch(const std::string& source, WatchUpdate& update) {
+    if (options_.eliminate_dead_code || options_.optimize_layout || has_virtual_registers_ || preprocessed_ ||
+        binary_included_ || mentions_incbin(source)) {
+        return false;
+    }
+
+    const auto old_lines = split_lines(source_);
+    const auto new_lines = split_lines(source);
+
+    // changed lines, 0-based and half-open: [begin, old_end) became [begin, old_end + delta)
+    const auto common = std::min(old_lines.size(), new_lines.size());
+    size_t prefix = 0;
+    while (prefix < common && old_lines[prefix] == new_lines[prefix]) ++prefix;
+    size_t suffix = 0;
+    while (suffix < common - prefix &&
+           old_lines[old_lines.size() - 1 - suffix] == new_lines[new_lines.size() - 1 - suffix]) {
+        ++suffix;
+    }
+    if (prefix == old_lines.size() && prefix == new_lines.size()) return true;
+
+    auto begin = prefix;
+    auto old_end = old_lines.size() - suffix;
+    const auto delta = static_cast<long>(new_lines.size()) - static_cast<long>(old_lines.size());
+
+    // widen to whole statements: several may share a line and one may span several
+    auto& nodes = ast_.nodes;
+    size_t first;
+    size_t last;
+    while (true) {
+        first = std::partition_point(nodes.begin(), nodes.end(), [&](const auto& node) {
+            return static_cast<size_t>(node->end_line) <= begin;
+        }) - nodes.begin();
+        last = first;
+        while (last < nodes.size() && static_cast<size_t>(nodes[last]->line) - 1 < old_end) ++last;
+        if (first == last) break;
+
+        const auto widened_begin = std::min(begin, static_cast<size_t>(nodes[first]->line) - 1);
+        const auto widened_end = std::max(old_end, static_cast<size_t>(nodes[last - 1]->end_line));
+        if (widened_begin == begin && widened_end == old_end) break;
+        begin = widened_begin;
+        old_end = widened_end;
+    }
+    const auto new_end = static_cast<size_t>(static_cast<long>(old_end) + delta);
+
+    std::string fragment;
+    for (auto i = begin; i < new_end; ++i) {
+        if (i > begin) fragment += '\n';
+        fragment += new_lines[i];
+    }
+    if (mentions_virtual_register(fragment) || uses_preprocessor(fragment)) return false;
+
+    // the piece's label IDs must match those already in the AST and symbol table
+    Lexer lexer(fragment, ast_.symbols, options_.core);
+    Parser parser(lexer);
+    auto piece = parser.parse().nodes;
+    for (const auto& node : piece) {
+        node->line += static_cast<int>(begin);
+        node->end_line += static_cast<int>(begin);
+        if (is_open_word(node.get())) return false;
+    }
+    if (first > 0 && is_open_word(nodes[first - 1].get())) return false;
+    update.lines_relexed = new_end - begin;
+
+    auto relaid = last - first != piece.size();
+    for (size_t k = 0; !relaid && k < piece.size(); ++k) {
+        relaid = !same_layout(nodes[first + k].get(), piece[k].get());
+    }
+
+    if (!relaid) {
+        // every address stays put: encode the new statements, and only once all of
+        // them are valid write them over the old words
+        std::vector<std::pair<uint32_t, uint32_t>> instruction_words;
+        std::vector<std::pair<uint32_t, uint32_t>> data_words;
+        for (size_t k = 0; k < piece.size(); ++k) {
+            const auto& node = piece[k];
+            node->address = nodes[first + k]->address;
+            node->section = nodes[first + k]->section;
+            if (node->type == NodeType::INSTRUCTION) {
+                code_gen_.check_instruction(node.get(), node->section);
+                instruction_words.emplace_back(node->address, code_gen_.encode_instruction(node.get(), symbols_));
+            } else if (const auto* dir = dynamic_cast<const DirectiveNode*>(node.get());
+                       dir && dir->name == "word" && node->section == Section::DATA) {
+                for (size_t i = 0; i < dir->values.size(); ++i) {
+                    data_words.emplace_back(node->address + 4 * i, code_gen_.encode_word(dir->values[i], symbols_, 0, dir->symbol(i)));
+                }
+            }
+        }
+
+        for (const auto& [pos, word] : instruction_words) {
+            update.instructions_changed |= utils::read_uint32(&output_.instructions[pos]) != word;
+            utils::write_uint32(&output_.instructions[pos], word);
+        }
+        for (const auto& [pos, word] : data_words) {
+            update.data_changed |= utils::read_uint32(&output_.data[pos]) != word;
+            utils::write_uint32(&output_.data[pos], word);
+        }
+        update.words_encoded = instruction_words.size() + data_words.size();
+    }
+
+    const auto fresh_count = piece.size();
+    nodes.erase(nodes.begin() + first, nodes.begin() + last);
+    nodes.insert(nodes.begin() + first, std::make_move_iterator(piece.begin()), std::make_move_iterator(piece.end()));
+    for (auto i = first + fresh_count; i < nodes.size(); ++i) {
+        nodes[i]->line += static_cast<int>(delta);
+        nodes[i]->end_line += static_cast<int>(delta);
+    }
+    if (!relaid) return true;
+
+    // statements came, went or changed size: reassign addresses, then re-encode only
+    // the new words and those that depend on a label or an address that moved
+    update.relaid = true;
+    std::vector<uint32_t> old_addresses;
+    old_addresses.reserve(nodes.size());
+    for (const auto& node : nodes) old_addresses.push_back(node->address);
+
+    const auto old_symbols = std::move(symbols_);
+    symbols_ = code_gen_.pass1(ast_);
+    const auto moved = [&](const std::string& name) { return old_symbols.get(name) != symbols_.get(name); };
+    // a branch keeps its offset when it moved together with its target
+    const auto offset_changed = [&](const std::string& name, const uint32_t shift) {
+        const auto before = old_symbols.get(name);
+        const auto after = symbols_.get(name);
+        return !before || !after || *after - *before != shift;
+    };
+
+    size_t text_size = 0;
+    size_t data_size = 4 * code_gen_.literal_pool().size();
+    for (const auto& node : nodes) {
+        if (node->type == NodeType::INSTRUCTION && node->section == Section::TEXT) {
+            text_size += 4;
+        } else if (const auto* dir = dynamic_cast<const DirectiveNode*>(node.get());
+                   dir && node->section == Section::DATA) {
+            data_size += dir->data_size();
+        }
+    }
+
+    BinaryOutput output;
+    output.instructions.resize(text_size);
+    output.data.resize(data_size);
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const auto* node = nodes[i].get();
+        const auto fresh = i >= first && i < first + fresh_count;
+        if (node->type == NodeType::INSTRUCTION && node->section == Section::TEXT) {
+            const auto* symbol = referenced_symbol(node);
+            auto stale = fresh;
+            if (!stale && symbol) {
+                stale = is_relative_branch(node) ? offset_changed(*symbol, node->address - old_addresses[i])
+                                                 : moved(*symbol);
+            }
+            // jumps are checked against the region of the next instruction
+            if (!stale && dynamic_cast<const JTypeInst*>(node)) {
+                stale = ((node->address + 4) >> 28) != ((old_addresses[i] + 4) >> 28);
+            }
+            if (stale) {
+                utils::write_uint32(&output.instructions[node->address], code_gen_.encode_instruction(node, symbols_));
+                ++update.words_encoded;
+            } else {
+                std::copy_n(output_.instructions.begin() + old_addresses[i], 4, output.instructions.begin() + node->address);
+            }
+        } else if (const auto* dir = dynamic_cast<const DirectiveNode*>(node);
+                   dir && dir->name == "word" && node->section == Section::DATA) {
+            for (size_t v = 0; v < dir->values.size(); ++v) {
+                const auto pos = node->address + 4 * v;
+                if (fresh || moved(dir->values[v])) {
+                    utils::write_uint32(&output.data[pos], code_gen_.encode_word(dir->values[v], symbols_, 0, dir->symbol(v)));
+                    ++update.words_encoded;
+                } else {
+                    std::copy_n(output_.data.begin() + old_addresses[i] + 4 * v, 4, output.data.begin() + pos);
+                }
+            }
+        }
+    }
+
+    // the pool is small and its entries may name labels, so it is always re-encoded
+    auto pool_pos = data_size - 4 * code_gen_.literal_pool().size();
+    for (size_t v = 0; v < code_gen_.literal_pool().size(); ++v) {
+        utils::write_uint32(&output.data[pool_pos], code_gen_.encode_literal(v, symbols_));
+        pool_pos += 4;
+        ++update.words_encoded;
+    }
+
+    update.instructions_changed = output.instructions != output_.instructions;
+    update.data_changed = output.data != output_.data;
+    output_ = std::move(output);
+    return true;
+}
+
+void watch(
+    const std::string& input_path,
+    const std::string& instruction_template_path, const std::string& instruction_file_path,
+    const std::string& data_template_path, const std::string& data_file_path,
+    const AssemblerOptions& options
+) {
+    // included files are lexed again only when they change
+    FragmentCache fragments;
+    auto watched_options = options;
+    watched_options.fragments = &fragments;
+    IncrementalAssembler assembler(watched_options);
+    TemplateCache templates;
+    std::optional<std::filesystem::file_time_type> seen;
+    // the files the last assembly included, with their times when it started; none for a missing one
+    std::vector<std::pair<std::string, std::optional<std::filesystem::file_time_type>>> included;
+    auto written = false;
+
+    while (true) {
+        std::error_code ec;
+        const auto mtime = std::filesystem::last_write_time(input_path, ec);
+        auto changed = mtime != seen;
+        for (auto& [path, included_mtime] : included) {
+            const auto now = modification_time(path);
+            changed |= now != included_mtime;
+            included_mtime = now;
+        }
+        if (!ec && changed) {
+            seen = mtime;
+            try {
+                const auto start = std::chrono::steady_clock::now();
+
+                std::ifstream in(input_path);
+                if (!in) throw std::runtime_error("Failed to open input file: " + input_path);
+                std::string input((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+                const auto update = assembler.update(std::move(input));
+                const auto& [instructions, data] = assembler.output();
+                const auto write_instructions = !written || update.instructions_changed;
+                const auto write_data = !written || update.data_changed;
+                if (write_instructions) {
+                    utils::write_file(instruction_file_path,
+                                      utils::render_template(*templates.get(instruction_template_path), instructions));
+                }
+                if (write_data) {
+                    utils::write_file(data_file_path, utils::render_template(*templates.get(data_template_path), data));
+                }
+                written = true;
+
+                const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                std::cout << "Assembled in " << std::fixed << std::setprecision(3) << elapsed.count() << " ms ("
+                          << (update.full ? "full" : update.relaid ? "relaid" : "in place") << ", "
+                          << update.lines_relexed << " lines lexed, " << update.words_encoded << " words encoded";
+                if (write_instructions) std::cout << ", " << instruction_file_path << " written";
+                if (write_data) std::cout << ", " << data_file_path << " written";
+                std::cout << ")" << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << "Assembly error: " << e.what() << std::endl;
+            }
+
+            // a file included for the first time is timed now; the rest keep the time read before the assembly
+            decltype(included) next;
+            for (const auto& path : assembler.included_files()) {
+                const auto it = std::ranges::find(included, path, &decltype(included)::value_type::first);
+                next.emplace_back(path, it != included.end() ? it->second : modification_time(path));
+            }
+            included = std::move(next);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+
+#include "assembler.h"
+#include "code_gen.h"
+#include "symbol_table.h"
+
+#include <string>
+
+
+// what an update had to redo
+struct WatchUpdate {
+    bool full = false;           // the whole pipeline ran again
+    bool relaid = false;         // pass1 ran again because statements were added, removed or resized
+    size_t lines_relexed = 0;
+    size_t words_encoded = 0;
+    bool instructions_changed = false;
+    bool data_changed = false;
+};
+
+// keeps the parsed program, its symbols and the encoded memories between edits.
+// an update re-lexes only the lines that differ from the previous source, splices
+// the resulting statements into the AST and re-encodes the words that depend on them;
+// every other word is copied from the previous output
+class IncrementalAssembler {
+public:
+    explicit IncrementalAssembler(AssemblerOptions options = {});
+
+    WatchUpdate update(std::string source);
+    [[nodiscard]] const BinaryOutput& output() const { return output_; }
+    // the .include and .incbin files of the last full assembly, also when it failed
+    [[nodiscard]] const std::vector<std::string>& included_files() const { return included_files_; }
+
+private:
+    WatchUpdate rebuild();
+    // false when the edit has to go through a full rebuild
+    bool patch(const std::string& source, WatchUpdate& update);
+
+    AssemblerOptions options_;
+    CodeGenerator code_gen_;
+    std::string source_;
+    AST ast_;
+    SymbolTable symbols_;
+    BinaryOutput output_;
+    bool valid_ = false;
+    bool has_virtual_registers_ = false;
+    bool preprocessed_ = false; // uses .include or .macro
+    bool binary_included_ = false; // uses .incbin
+    std::vector<std::string> included_files_;
+};
+
+// assembles the input into the two memory files, then polls it and the files it
+// includes and reassembles after every change until the process is killed
+[[noreturn]] void watch(
+    const std::string& input_path,
+    const std::string& instruction_template_path, const std::string& instruction_file_path,
+    const std::string& data_template_path, const std::string& data_file_path,
+    const AssemblerOptions& options
+);
+
+#endif // WATCH_H
@@ -0,0 +1,46 @@
+#ifndef CHECKS_H
+#define CHECKS_H
+
+
+#include "utils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+
+// ctest's SKIP_RETURN_CODE, for checks this platform cannot run
+inline constexpr int SKIPPED = 77;
+
+// the big-endian words of an encoded section
+inline std::vector<uint32_t> words(const std::vector<uint8_t>& bytes) {
+    std::vector<uint32_t> result;
+    for (size_t i = 0; i + 3 < bytes.size(); i += 4) {
+        result.push_back(utils::read_uint32(&bytes[i]));
+    }
+    return result;
+}
+
+// generates adversarial sources - floods of comment lines, huge identifiers and
+// .word lists, long label chains, runs of illegal characters - at n and 4n units,
+// and checks that lexing, parsing and both code generator passes stay linear in
+// time and memory and fit a small stack. Each size runs in a child process, so a
+// stack overflow is reported instead of taking the suite down.
+// Prints a table per input and returns how many inputs failed, or SKIPPED.
+int run_scaling_suite(std::ostream& out, size_t n);
+
+// compares the scan kernels at every level the CPU supports with byte-by-byte
+// loops at every position of 400 random inputs, and the lexer's tokens with
+// those it gives on the scalar kernels; returns the number of failed levels
+int run_scan_check(std::ostream& out);
+
+// the programs static_assert-ed in static_assembler_check.cpp, assembled again by
+// the runtime passes; returns how many came out different
+int run_static_assembler_check(std::ostream& out);
+
+// small programs that once assembled wrongly, with the words or the error they
+// must give now; returns how many did not
+int run_regression_checks(std::ostream& out);
+
+#endif // CHECKS_H
@@ -0,0 +1,30 @@
+#include "checks.h"
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+
+// assembler_tests <check> [args]; each check is its own ctest entry
+int main(int argc, char* argv[]) {
+    const std::string check = argc >= 2 ? argv[1] : "";
+    try {
+        int failures;
+        if (check == "scaling") {
+            failures = run_scaling_suite(std::cout, argc >= 3 ? std::stoul(argv[2]) : 100000);
+        } else if (check == "scan") {
+            failures = run_scan_check(std::cout);
+        } else if (check == "static_assembler") {
+            failures = run_static_assembler_check(std::cout);
+        } else if (check == "regressions") {
+            failures = run_regression_checks(std::cout);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " (scaling [n] | scan | static_assembler | regressions)\n";
+            return 1;
+        }
+        return failures == 0 || failures == SKIPPED ? failures : 1;
+    } catch (const std::exception& e) {
+        std::cerr << check << ": " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,120 @@
+#include "checks.h"
+#include "assembler.h"
+#include "watch.h"
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+struct Case {
+    const char* name;
+    const char* source;
+    AssemblerOptions options;
+    std::vector<uint32_t> text; // the expected .text words, unless error is set
+    const char* error = nullptr; // a part of the expected error message
+    std::optional<std::vector<uint32_t>> data{}; // the expected .data words, if checked
+};
+
+AssemblerOptions core(const TargetCore target, const bool eliminate_dead_code = false,
+                      const bool optimize_layout = false) {
+    AssemblerOptions options;
+    options.core = target;
+    options.eliminate_dead_code = eliminate_dead_code;
+    options.optimize_layout = optimize_layout;
+    return options;
+}
+
+constexpr uint32_t ADD = 0x0319C020; // add $t0, $t0, $t1
+
+const std::vector<Case>& cases() {
+    static const std::vector<Case> CASES = {
+        {"classic labels named after extended mnemonics",
+         ".text\nj:\nadd $t0, $t0, $t1\nbeq $r0, $r0, j\n", core(TargetCore::CLASSIC), {0x0319C020, 0x1108FFFE}},
+        {"extended mnemonic on the classic core", ".text\nj done\ndone: add $t0, $t0, $t1\n",
+         core(TargetCore::CLASSIC), {}, "not supported by the classic core"},
+        {"extended mnemonic on the extended core", ".text\nj done\ndone: add $t0, $t0, $t1\n",
+         core(TargetCore::EXTENDED), {0x08000001, 0x0319C020}},
+        {"numeric jump target under --eliminate-dead",
+         ".text\nj 12\nadd $t0, $t0, $t1\nadd $t0, $t0, $t1\nadd $t0, $t0, $t1\nadd $t0, $t0, $t1\n",
+         core(TargetCore::EXTENDED, true), {0x08000003, ADD, ADD, ADD, ADD}},
+        {"numeric jump target under --layout",
+         ".text\nadd $t0, $t0, $t1\nbeq $r0, $r0, c\nb: add $t0, $t0, $t1\nj 0\nc: add $t0, $t0, $t1\n"
+         "beq $r0, $r0, b\n",
+         core(TargetCore::EXTENDED, false, true), {ADD, 0x11080002, ADD, 0x08000000, ADD, 0x1108FFFC}},
+        {"base register a0 under --eliminate-dead", ".text\nlw $t0, 4($a0)\n.data\na: .word 1\nb: .word 2\n",
+         core(TargetCore::CLASSIC, true), {0x8C180004}, nullptr, {{1, 2}}},
+        {"numeric offset on a non-zero base under --eliminate-dead",
+         ".text\nlw $t0, 4($t1)\n.data\na: .word 1\nb: .word 2\n", core(TargetCore::CLASSIC, true),
+         {0x8F380004}, nullptr, {{1, 2}}},
+        {"undefined label in a literal", ".text\nadd $t0, $t0, $t1\nlw $t0, =nolabel\n", core(TargetCore::CLASSIC),
+         {}, "Unresolved label in literal =nolabel at line 3"},
+    };
+    return CASES;
+}
+
+void write_blob(const std::filesystem::path& path, const std::string& bytes) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+}
+
+// --watch used to patch an .incbin program in place and keep the old bytes of the file
+std::string incbin_after_blob_edit() {
+    const auto blob = std::filesystem::temp_directory_path() / "assembler_regressions_blob.bin";
+    const auto source = ".text\nadd $t0, $t0, $t1\n.data\n.incbin \"" + blob.generic_string() + "\"\n";
+    write_blob(blob, "AAAA");
+    IncrementalAssembler assembler;
+    assembler.update(source);
+
+    std::string outcome;
+    write_blob(blob, "BBBB");
+    assembler.update(std::string(source).replace(source.find("$t1"), 3, "$t2"));
+    if (words(assembler.output().data) != std::vector<uint32_t>{0x42424242}) outcome = "kept the old blob";
+
+    write_blob(blob, std::string(64 * 1024, 'C'));
+    assembler.update(source);
+    write_blob(blob, "");
+    assembler.update(std::string(source).replace(source.find("$t1"), 3, "$t2"));
+    if (outcome.empty() && !assembler.output().data.empty()) outcome = "kept the truncated blob";
+
+    std::filesystem::remove(blob);
+    return outcome;
+}
+
+}
+
+int run_regression_checks(std::ostream& out) {
+    int failures = 0;
+    for (const auto& c : cases()) {
+        std::string outcome;
+        try {
+            const auto output = Assembler(c.source, c.options).encode();
+            if (c.error) {
+                outcome = "assembled, expected an error";
+            } else if (words(output.instructions) != c.text) {
+                outcome = "encoded .text differently";
+            } else if (c.data && words(output.data) != *c.data) {
+                outcome = "encoded .data differently";
+            }
+        } catch (const std::exception& e) {
+            if (!c.error || std::string(e.what()).find(c.error) == std::string::npos) {
+                outcome = std::string("failed: ") + e.what();
+            }
+        }
+        out << c.name << ": " << (outcome.empty() ? "ok" : "FAILED, " + outcome) << "\n";
+        failures += !outcome.empty();
+    }
+
+    std::string outcome;
+    try {
+        outcome = incbin_after_blob_edit();
+    } catch (const std::exception& e) {
+        outcome = std::string("failed: ") + e.what();
+    }
+    out << ".incbin edited under --watch: " << (outcome.empty() ? "ok" : "FAILED, " + outcome) << "\n";
+    failures += !outcome.empty();
+    return failures;
+}
@@ -0,0 +1,268 @@
+#include "checks.h"
+#include "code_gen.h"
+#include "perf_counters.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <csignal>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+
+// a recursion per line or per token overflows this long before the large inputs end
+constexpr size_t STACK_BYTES = 256u << 10;
+// 4x the input may cost up to this many times as much before it counts as superlinear:
+// quadratic work costs 16 times as much, cache misses on the larger tables push linear work past 4
+constexpr double MAX_RATIO = 10.0;
+// below these, the small run is mostly noise and the floor is compared instead
+constexpr double MIN_MILLISECONDS = 2.0;
+constexpr double MIN_KIB = 4096.0;
+// the fastest of these is kept, the machine may be busy
+constexpr int RUNS = 3;
+
+constexpr std::array<const char*, 4> PHASES = {"lex", "lex+parse", "pass1", "pass2"};
+
+struct Input {
+    const char* name;
+    const char* unit;
+    size_t per_n; // units per n
+    std::string (*generate)(size_t units);
+};
+
+constexpr const char* INSTRUCTION = "add $t0, $t0, $t0\n";
+
+std::string comment_lines(const size_t units) {
+    std::string text;
+    text.reserve(16 * units + 32);
+    for (size_t i = 0; i < units; ++i) text += "; comment line\n";
+    return text + INSTRUCTION;
+}
+
+std::string long_identifier(const size_t units) {
+    const auto name = "l" + std::string(units, 'x');
+    return "j " + name + "\n" + name + ": " + INSTRUCTION;
+}
+
+std::string word_list(const size_t units) {
+    std::string text = ".data\ntable: .word 0";
+    text.reserve(12 * units + 64);
+    for (size_t i = 1; i < units; ++i) text += ", " + std::to_string(i);
+    return text + "\n.text\n" + INSTRUCTION;
+}
+
+// every label jumps to the next one
+std::string label_chain(const size_t units) {
+    std::string text;
+    text.reserve(24 * units + 32);
+    for (size_t i = 0; i < units; ++i) text += "l" + std::to_string(i) + ": j l" + std::to_string(i + 1) + "\n";
+    return text + "l" + std::to_string(units) + ": " + INSTRUCTION;
+}
+
+// all at the same address
+std::string stacked_labels(const size_t units) {
+    std::string text;
+    text.reserve(12 * units + 64);
+    for (size_t i = 0; i < units; ++i) text += "l" + std::to_string(i) + ":\n";
+    return text + INSTRUCTION + "beq $t0, $t1, l0\n";
+}
+
+// the parser skips the garbage in front of each instruction
+std::string illegal_runs(const size_t units) {
+    std::string text;
+    text.reserve(32 * units);
+    for (size_t i = 0; i < units; ++i) text += std::string("@#~?! ") + INSTRUCTION;
+    return text;
+}
+
+const std::array<Input, 6> INPUTS = {{
+    {"comment lines", "lines", 10, comment_lines},
+    {"long identifier", "characters", 16, long_identifier},
+    {".word list", "values", 1, word_list},
+    {"label chain", "labels", 1, label_chain},
+    {"stacked labels", "labels", 1, stacked_labels},
+    {"illegal characters", "lines", 1, illegal_runs},
+}};
+
+struct Result {
+    std::array<double, PHASES.size()> milliseconds{}; // fastest run of each phase
+    long peak_kib = 0;                                 // how far the run raised the peak resident set
+    size_t bytes = 0;                                  // of source
+    char error[256] = {};
+};
+
+struct Job {
+    const Input* input;
+    size_t units;
+    Result result;
+};
+
+void* run_job(void* arg) {
+    auto& job = *static_cast<Job*>(arg);
+    auto& result = job.result;
+    try {
+        const auto source = job.input->generate(job.units);
+        result.bytes = source.size();
+
+        // the extended core, so the inputs can use j
+        PhaseProfiler profiler;
+        for (int run = 0; run < RUNS; ++run) {
+            profiler.measure(PHASES[0], [&] {
+                Lexer lexer(source, std::make_shared<SymbolInterner>(), TargetCore::EXTENDED);
+                while (lexer.next_token().type != TokenType::EoF) {}
+            });
+            auto ast = profiler.measure(PHASES[1], [&] {
+                Lexer lexer(source, std::make_shared<SymbolInterner>(), TargetCore::EXTENDED);
+                Parser parser(lexer);
+                return parser.parse();
+            });
+            CodeGenerator code_gen(TargetCore::EXTENDED);
+            const auto sym_table = profiler.measure(PHASES[2], [&] { return code_gen.pass1(ast); });
+            profiler.measure(PHASES[3], [&] { return code_gen.pass2(ast, sym_table); });
+        }
+
+        result.milliseconds.fill(std::numeric_limits<double>::infinity());
+        for (const auto& phase : profiler.phases()) {
+            const auto index = std::find(PHASES.begin(), PHASES.end(), phase.name) - PHASES.begin();
+            result.milliseconds[index] = std::min(result.milliseconds[index], phase.milliseconds);
+        }
+    } catch (const std::exception& e) {
+        std::snprintf(result.error, sizeof(result.error), "%s", e.what());
+    }
+    return nullptr;
+}
+
+#ifndef _WIN32
+// in a child, on a thread with a STACK_BYTES stack
+Result measure(const Input& input, const size_t units) {
+    int fds[2];
+    if (pipe(fds) != 0) throw std::runtime_error("Failed to create a pipe for the scaling suite");
+    const auto pid = fork();
+    if (pid < 0) throw std::runtime_error("Failed to fork for the scaling suite");
+
+    if (pid == 0) {
+        close(fds[0]);
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        const auto base = usage.ru_maxrss;
+
+        Job job{&input, units, {}};
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, STACK_BYTES);
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, run_job, &job) == 0) {
+            pthread_join(thread, nullptr);
+        } else {
+            std::snprintf(job.result.error, sizeof(job.result.error), "Failed to start a thread");
+        }
+        getrusage(RUSAGE_SELF, &usage);
+        job.result.peak_kib = usage.ru_maxrss - base;
+
+        const auto* bytes = reinterpret_cast<const char*>(&job.result);
+        for (size_t done = 0; done < sizeof(Result);) {
+            const auto written = write(fds[1], bytes + done, sizeof(Result) - done);
+            if (written <= 0) _exit(1);
+            done += static_cast<size_t>(written);
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    Result result;
+    auto* bytes = reinterpret_cast<char*>(&result);
+    size_t done = 0;
+    for (ssize_t got; done < sizeof(Result) && (got = read(fds[0], bytes + done, sizeof(Result) - done)) > 0;) {
+        done += static_cast<size_t>(got);
+    }
+    close(fds[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (WIFSIGNALED(status)) {
+        result = {};
+        std::snprintf(result.error, sizeof(result.error), "killed by signal %d%s", WTERMSIG(status),
+                      WTERMSIG(status) == SIGSEGV ? ", most likely a stack overflow" : "");
+    } else if (done != sizeof(Result)) {
+        result = {};
+        std::snprintf(result.error, sizeof(result.error), "exited without a result");
+    }
+    return result;
+}
+#endif
+
+double ratio(const double large, const double small, const double floor) {
+    return large / std::max(small, floor);
+}
+
+}
+
+int run_scaling_suite(std::ostream& out, const size_t n) {
+#ifdef _WIN32
+    (void)n;
+    out << "The scaling suite needs fork(), which is not available on this platform\n";
+    return SKIPPED;
+#else
+    const utils::StreamFormatGuard guard(out);
+
+    out << "Scaling suite: each input at n and 4n units (n = " << n << "), fastest of " << RUNS << " runs on a "
+        << (STACK_BYTES >> 10) << " KiB stack; ratios above " << MAX_RATIO << " fail\n";
+
+    int failures = 0;
+    for (const auto& input : INPUTS) {
+        const auto small_units = input.per_n * n;
+        const std::array<Result, 2> results = {measure(input, small_units), measure(input, 4 * small_units)};
+
+        out << "\n" << input.name << ": " << small_units << " and " << 4 * small_units << " " << input.unit << "\n"
+            << std::left << std::setw(8) << "" << std::right << std::setw(12) << "bytes";
+        for (const auto* phase : PHASES) out << std::setw(12) << phase;
+        out << std::setw(12) << "peak KiB" << "\n";
+
+        std::string error;
+        for (size_t i = 0; i < results.size(); ++i) {
+            const auto& result = results[i];
+            if (result.error[0] != '\0') {
+                error = std::string(i == 0 ? "n" : "4n") + ": " + result.error;
+                break;
+            }
+            out << std::left << std::setw(8) << (i == 0 ? "n" : "4n") << std::right << std::setw(12) << result.bytes
+                << std::fixed << std::setprecision(2);
+            for (const auto milliseconds : result.milliseconds) out << std::setw(12) << milliseconds;
+            out << std::setw(12) << result.peak_kib << "\n";
+        }
+        if (!error.empty()) {
+            out << "FAILED, " << error << "\n";
+            ++failures;
+            continue;
+        }
+
+        auto worst = 0.0;
+        out << std::left << std::setw(8) << "ratio" << std::right << std::setw(12) << "";
+        for (size_t p = 0; p < PHASES.size(); ++p) {
+            const auto r = ratio(results[1].milliseconds[p], results[0].milliseconds[p], MIN_MILLISECONDS);
+            worst = std::max(worst, r);
+            out << std::setw(12) << r;
+        }
+        const auto memory = ratio(static_cast<double>(results[1].peak_kib), static_cast<double>(results[0].peak_kib),
+                                  MIN_KIB);
+        worst = std::max(worst, memory);
+        out << std::setw(12) << memory << "\n" << (worst <= MAX_RATIO ? "ok" : "FAILED, superlinear") << "\n";
+        if (worst > MAX_RATIO) ++failures;
+    }
+
+    out << "\n" << (failures == 0 ? "All inputs scale linearly" : std::to_string(failures) + " input(s) failed") << "\n";
+    return failures;
+#endif
+}
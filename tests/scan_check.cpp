@@ -0,0 +1,121 @@
+#include "checks.h"
+#include "lexer.h"
+#include "scan.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace {
+
+using namespace std::string_view_literals;
+
+constexpr int INPUTS = 400;
+
+// byte by byte, the way the lexer read before the kernels
+size_t reference_skip_space(const std::string& s, size_t pos) {
+    while (pos < s.size() && (s[pos] == ' ' || (s[pos] >= '\t' && s[pos] <= '\r'))) ++pos;
+    return pos;
+}
+
+size_t reference_skip_ident(const std::string& s, size_t pos) {
+    while (pos < s.size() && (std::isalnum(static_cast<unsigned char>(s[pos])) || s[pos] == '_')) ++pos;
+    return pos;
+}
+
+size_t reference_find_line_end(const std::string& s, size_t pos) {
+    while (pos < s.size() && s[pos] != '\n' && s[pos] != '\0') ++pos;
+    return std::min(pos, s.size());
+}
+
+size_t reference_count_newlines(const std::string& s, const size_t begin, const size_t end) {
+    size_t count = 0;
+    for (auto pos = begin; pos < end; ++pos) count += s[pos] == '\n';
+    return count;
+}
+
+// runs of the byte classes the kernels tell apart, lengths around the 16 and 32 byte blocks
+std::string random_input(std::mt19937& random) {
+    static constexpr std::array<std::string_view, 8> ALPHABETS = {
+        " \t"sv, "\n\r\v\f"sv, "abcxyzABCXYZ"sv, "0123456789_"sv, ";,:.$()=\""sv, "\x80\xff@#~"sv, "\0"sv,
+        "add $t0, $t1, $t2 ; c\n"sv};
+    std::string text;
+    const auto runs = std::uniform_int_distribution<int>(0, 40)(random);
+    for (int run = 0; run < runs; ++run) {
+        const auto chars = ALPHABETS[std::uniform_int_distribution<size_t>(0, ALPHABETS.size() - 1)(random)];
+        const auto length = std::uniform_int_distribution<int>(1, 70)(random);
+        for (int i = 0; i < length; ++i) {
+            text += chars[std::uniform_int_distribution<size_t>(0, chars.size() - 1)(random)];
+        }
+    }
+    return text;
+}
+
+std::vector<Token> lex(const std::string& text) {
+    std::vector<Token> tokens;
+    Lexer lexer(text);
+    for (auto token = lexer.next_token(); token.type != TokenType::EoF; token = lexer.next_token()) {
+        tokens.push_back(std::move(token));
+    }
+    return tokens;
+}
+
+bool same(const std::vector<Token>& a, const std::vector<Token>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].type != b[i].type || a[i].literal != b[i].literal || a[i].line != b[i].line) return false;
+    }
+    return true;
+}
+
+}
+
+int run_scan_check(std::ostream& out) {
+    const auto initial = scan::level();
+    const std::array<std::pair<scan::Level, const char*>, 3> levels = {
+        {{scan::Level::SCALAR, "scalar"}, {scan::Level::SSE2, "SSE2"}, {scan::Level::AVX2, "AVX2"}}};
+
+    std::mt19937 random(20240605);
+    std::vector<std::string> inputs;
+    for (int i = 0; i < INPUTS; ++i) inputs.push_back(random_input(random));
+
+    // the token streams every level has to reproduce
+    scan::set_level(scan::Level::SCALAR);
+    std::vector<std::vector<Token>> expected;
+    for (const auto& input : inputs) expected.push_back(lex(input));
+
+    int failures = 0;
+    for (const auto& [level, name] : levels) {
+        if (level > scan::best_level()) {
+            out << name << ": not supported by this CPU, skipped\n";
+            continue;
+        }
+        scan::set_level(level);
+        int mismatches = 0;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            const auto& s = inputs[i];
+            const auto* data = s.data();
+            for (size_t pos = 0; pos <= s.size(); ++pos) {
+                if (scan::skip_space(data, pos, s.size()) != reference_skip_space(s, pos) ||
+                    scan::skip_ident(data, pos, s.size()) != reference_skip_ident(s, pos) ||
+                    scan::find_line_end(data, pos, s.size()) != reference_find_line_end(s, pos) ||
+                    scan::count_newlines(data, pos, s.size()) != reference_count_newlines(s, pos, s.size())) {
+                    if (mismatches++ == 0) out << name << ": kernel mismatch on input " << i << " at " << pos << "\n";
+                    break;
+                }
+            }
+            if (!same(lex(s), expected[i])) {
+                if (mismatches++ == 0) out << name << ": tokens differ from the scalar lexer on input " << i << "\n";
+            }
+        }
+        out << name << ": " << inputs.size() << " inputs, " << mismatches << " mismatch(es)\n";
+        failures += mismatches > 0;
+    }
+    scan::set_level(initial);
+    return failures;
+}
@@ -0,0 +1,88 @@
+#include "checks.h"
+#include "code_gen.h"
+#include "static_assembler.h"
+
+#include <string>
+#include <vector>
+
+
+namespace {
+
+// known encodings, checked while this file compiles: a change to the tables in
+// common.h that the header does not follow breaks the build here
+constexpr char POOL_SOURCE[] = R"(
+    .data
+    .word 1, 2, 3, 4, 5
+    .text
+    loop: lw  $t0, =9
+          beq $r0, $r0, loop
+)";
+constexpr auto POOL = static_asm::assemble<POOL_SOURCE>();
+static_assert(POOL.text.size() == 2 && POOL.text[0] == 0x8C180014 && POOL.text[1] == 0x1108FFFE);
+static_assert(POOL.data.size() == 6 && POOL.data[0] == 1 && POOL.data[5] == 9);
+
+constexpr char CLASSIC_SOURCE[] = R"(
+    .data
+    vals: .word 7, -1, vals
+    buf:  .space 6
+    .text
+    start: add $t0, $t1, $t2
+           sub $s0, $s1, $s2
+           sll $t0, $t1, 3
+           lw  $t1, 4($a1)
+           sw  $t1, vals
+           beq $t0, $t1, start
+)";
+constexpr auto CLASSIC = static_asm::assemble<CLASSIC_SOURCE>();
+static_assert(CLASSIC.text == std::array<uint32_t, 6>{0x033AC020, 0x02328022, 0x0019C0C4, 0x8C390004, 0xAC190000,
+                                                      0x1319FFFA});
+static_assert(CLASSIC.data == std::array<uint32_t, 5>{7, 0xFFFFFFFF, 0, 0, 0});
+
+constexpr char EXTENDED_SOURCE[] = R"(
+    .text
+    start: addi $t0, $t1, -5
+           bne  $t0, $t1, start
+           slt  $t2, $t0, $t1
+           ori  $t3, $t3, 0xff
+           jal  start
+           j    done
+    done:  andi $t0, $t0, 1
+)";
+constexpr auto EXTENDED = static_asm::assemble<EXTENDED_SOURCE, TargetCore::EXTENDED>();
+static_assert(EXTENDED.text == std::array<uint32_t, 7>{0x2338FFFB, 0x1719FFFE, 0x0319D02A, 0x377B00FF, 0x0C000000,
+                                                       0x08000006, 0x33180001});
+
+// the classic core has no j, so it is a label name there
+constexpr auto LABEL_J = static_asm::assemble<R"(
+    .text
+    j: add $t0, $t0, $t1
+       beq $r0, $r0, j
+)">();
+static_assert(LABEL_J.text == std::array<uint32_t, 2>{0x0319C020, 0x1108FFFE});
+
+// the runtime passes give the same words as the header
+template <typename Program>
+bool same_as_runtime(std::ostream& out, const char* name, const char* source, const Program& program,
+                     const TargetCore core) {
+    Lexer lexer(source, std::make_shared<SymbolInterner>(), core);
+    Parser parser(lexer);
+    auto ast = parser.parse();
+    CodeGenerator code_gen(core);
+    const auto sym_table = code_gen.pass1(ast);
+    const auto output = code_gen.pass2(ast, sym_table);
+
+    const auto same = words(output.instructions) == std::vector<uint32_t>(program.text.begin(), program.text.end()) &&
+                      words(output.data) == std::vector<uint32_t>(program.data.begin(), program.data.end());
+    out << name << ": " << (same ? "same as the runtime assembler" : "DIFFERS from the runtime assembler") << "\n";
+    return same;
+}
+
+}
+
+int run_static_assembler_check(std::ostream& out) {
+    int failures = 0;
+    failures += !same_as_runtime(out, "literal pool", POOL_SOURCE, POOL, TargetCore::CLASSIC);
+    failures += !same_as_runtime(out, "classic core", CLASSIC_SOURCE, CLASSIC, TargetCore::CLASSIC);
+    failures += !same_as_runtime(out, "extended core", EXTENDED_SOURCE, EXTENDED, TargetCore::EXTENDED);
+    return failures;
+}